@@ -0,0 +1,86 @@
+#include "tokeniser.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+/**
+* Tokeniser benchmark.
+* Usage: CNES_TokeniserBenchmark [source file] [megabytes] [iterations]
+* Without a source file, a generated source (level-data tables and functions) is used.
+* The source is repeated until it is at least [megabytes] large (default: 16).
+*/
+
+static std::string GenerateSource()
+{
+    std::string source;
+    source += "#define TILE_COUNT 64\n";
+    source += "uint8_t counter;\n";
+    for (int iTable = 0; iTable < 16; ++iTable)
+    {
+        source += "uint8_t level_" + std::to_string(iTable) + "_tile;\n";
+    }
+    source += "uint8_t update_tile(uint8_t tile) // advance tile\n{\n";
+    source += "    if (tile != TILE_COUNT)\n    {\n        tile = tile + 1;\n    }\n";
+    source += "    __asm lda $4016\n    __asm sta $4015\n    return tile;\n}\n";
+    source += "void main()\n{\n    while (1 == 1)\n    {\n";
+    for (int iTable = 0; iTable < 16; ++iTable)
+    {
+        const std::string name = "level_" + std::to_string(iTable) + "_tile";
+        source += "        " + name + " = update_tile(" + name + ");\n";
+        source += "        counter = counter + " + std::to_string(iTable) + ";\n";
+    }
+    source += "    }\n}\n";
+    return source;
+}
+
+int main(int args, char** argv)
+{
+    std::string source;
+    if (args > 1)
+    {
+        std::ifstream fileStream(argv[1]);
+        if (!fileStream)
+        {
+            printf("Failed to open: %s\n", argv[1]);
+            return 1;
+        }
+        source.assign((std::istreambuf_iterator<char>(fileStream)), std::istreambuf_iterator<char>());
+    }
+    else
+        source = GenerateSource();
+
+    const size_t targetSize = static_cast<size_t>(args > 2 ? atoi(argv[2]) : 16) * 1024 * 1024;
+    const int iterations = args > 3 ? atoi(argv[3]) : 5;
+
+    std::string input;
+    input.reserve(targetSize + source.size());
+    while (input.size() < targetSize)
+        input += source;
+
+    size_t numTokens = 0;
+    double bestSeconds = 0.0;
+    for (int iIter = 0; iIter < iterations; ++iIter)
+    {
+        IdentifierTable identifierTable;
+        Tokeniser tokeniser(input.data(), input.size(), &identifierTable);
+        size_t iterTokens = 0;
+
+        const auto startTime = std::chrono::steady_clock::now();
+        while (tokeniser.ParseToken().mTokenType != ETokenType::EndOfFile)
+            iterTokens++;
+        const auto endTime = std::chrono::steady_clock::now();
+
+        const double seconds = std::chrono::duration<double>(endTime - startTime).count();
+        if (iIter == 0 || seconds < bestSeconds)
+            bestSeconds = seconds;
+        numTokens = iterTokens;
+    }
+
+    const double megabytes = static_cast<double>(input.size()) / (1024.0 * 1024.0);
+    printf("Input: %.2f MB, %zu tokens\n", megabytes, numTokens);
+    printf("Best of %d: %.3f s, %.2f M tokens/s, %.2f MB/s\n", iterations, bestSeconds, numTokens / bestSeconds / 1000000.0, megabytes / bestSeconds);
+
+    return 0;
+}
@@ -7,35 +7,45 @@ Analyser::Analyser(CompilationUnit* unit)
 {
     mCompilationUnit = unit;
 
-    mBuiltInTypes.emplace("uint8_t");
-    mBuiltInTypes.emplace("void");
+    mUInt8TypeSymbol = AddBuiltInType("uint8_t", 1);
+    AddBuiltInType("void", 0);
+    mUInt8TypeID = GetTypeID("uint8_t");
+}
+
+Symbol* Analyser::AddBuiltInType(const char* typeName, uint16_t size)
+{
+    // Visible in all scopes, but not part of the unit's symbol table. Freed with the unit.
+    Symbol* sym = mCompilationUnit->mArena.New<Symbol>();
+    sym->mName = sym->mUniqueName = typeName;
+    sym->mNameID = mCompilationUnit->mIdentifierTable->Intern(typeName);
+    sym->mSymbolType = ESymbolType::BuiltInType;
+    sym->mSize = size;
+    mScopedSymbols.AddSymbol(sym);
+    return sym;
+}
+
+IdentifierID Analyser::GetTypeID(std::string_view typeName)
+{
+    return mCompilationUnit->mIdentifierTable->Intern(typeName);
+}
+
+std::string_view Analyser::GetTypeName(IdentifierID typeID)
+{
+    return mCompilationUnit->mIdentifierTable->GetName(typeID);
 }
 
 bool Analyser::IsTypeIdentifier(const char* inTokenString)
 {
-    if (mBuiltInTypes.find(inTokenString) != mBuiltInTypes.end())
-        return true;
-    else
-    {
-        return GetSymbol(inTokenString, ESymbolType::All) != nullptr;
-    }
+    return GetSymbol(inTokenString, ESymbolType::All) != nullptr;
 }
 
-Symbol* Analyser::GetSymbol(const std::string& symbolName, ESymbolType symbolType)
+Symbol* Analyser::GetSymbol(std::string_view symbolName, ESymbolType symbolType)
 {
-    SymbolList* symList = mCurrentScope;
-    while (symList != nullptr)
-    {
-        Symbol* currSym = symList->mTail;
-        while (currSym != nullptr)
-        {
-            if (((currSym->mSymbolType & symbolType) != ESymbolType::None) && currSym->mName == symbolName)
-                return currSym;
-            currSym = currSym->mNext;
-        }
-        symList = symList->mParent;
-    }
-    return nullptr;
+    // Names that were never interned can't have a symbol
+    const IdentifierID nameID = mCompilationUnit->mIdentifierTable->Find(symbolName);
+    if (nameID == InvalidIdentifierID)
+        return nullptr;
+    return mScopedSymbols.Find(nameID, symbolType);
 }
 
 void Analyser::PushSybolStack(Symbol* symbol)
@@ -47,10 +57,12 @@ void Analyser::PushSybolStack(Symbol* symbol)
     symList->mOwningSymbol = symbol;
     symbol->mChildren = symList;
     mCurrentScope = symList;
+    mScopedSymbols.PushScope();
 }
 
 void Analyser::PopSybolStack()
 {
+    mScopedSymbols.PopScope();
     mCurrentScope = mCurrentScope->mParent;
 }
 
@@ -63,9 +75,12 @@ void Analyser::AddSymbol(Symbol* symbol)
     }
     else
     {
-        symList->mHead->mNext = symbol;
-        symList->mHead = symbol;
+        symList->mTail->mNext = symbol;
+        symList->mTail = symbol;
     }
+
+    symbol->mNameID = mCompilationUnit->mIdentifierTable->Intern(symbol->mName);
+    mScopedSymbols.AddSymbol(symbol);
 }
 
 void Analyser::GenerateUniqueName(Symbol* sym)
@@ -73,19 +88,17 @@ void Analyser::GenerateUniqueName(Symbol* sym)
     sym->mUniqueName = mCurrentScope->mName + std::string("_") + sym->mName;
 }
 
-bool Analyser::ConvertTypeName(const std::string& typeName, std::string& outUniqueName)
+bool Analyser::ResolveType(Symbol* sym, IdentifierID typeID)
 {
-    Symbol* typeSym = GetSymbol(typeName, ESymbolType::Struct);
-    if (typeSym != nullptr)
-        outUniqueName = typeSym->mUniqueName;
-    else if (mBuiltInTypes.find(typeName) != mBuiltInTypes.end()) // TODO: should built'in types have symbols?
-        outUniqueName = typeName;
-    else
+    Symbol* typeSym = GetSymbol(GetTypeName(typeID), ESymbolType::Struct | ESymbolType::BuiltInType);
+    if (typeSym == nullptr)
     {
-        LOG_ERROR() << "Invalid type type: " << typeName;
+        LOG_ERROR() << "Invalid type type: " << GetTypeName(typeID);
         OnError();
         return false;
     }
+    sym->mTypeSymbol = typeSym;
+    sym->mTypeName = typeSym->mUniqueName;
     return true;
 }
 
@@ -116,7 +129,8 @@ Symbol* Analyser::VisitStructDefNode(StructDefinition* node)
         AddSymbol(sym);
     }
     // Update node name
-    node->mName = sym->mUniqueName;
+    node->mName = mCompilationUnit->mArena.CopyString(sym->mUniqueName);
+    node->mSymbol = sym;
 
     if (sym->mChildren != nullptr && node->mContent != nullptr)
     {
@@ -154,14 +168,15 @@ Symbol* Analyser::VisitFuncDefNode(FunctionDefinition* node)
         sym->mSymbolType = ESymbolType::Function;
         // Generate unique name
         GenerateUniqueName(sym);
-        // Convert type name
-        if (!ConvertTypeName(node->mType, sym->mTypeName))
+        // Resolve type
+        if (!ResolveType(sym, node->mType))
             return nullptr;
         AddSymbol(sym);
     }
     // Update name
-    node->mName = sym->mUniqueName;
-    node->mType = sym->mTypeName;
+    node->mName = mCompilationUnit->mArena.CopyString(sym->mUniqueName);
+    node->mType = GetTypeID(sym->mTypeName);
+    node->mSymbol = sym;
 
     if (sym->mChildren != nullptr && node->mContent != nullptr)
     {
@@ -224,20 +239,21 @@ Symbol* Analyser::VisitVarDefStatement(VarDefStatement* node)
         AddSymbol(sym);
         // Generate unique name
         GenerateUniqueName(sym);
-        // Convert type name
-        if (!ConvertTypeName(node->mType, sym->mTypeName))
+        // Resolve type
+        if (!ResolveType(sym, node->mType))
             return nullptr;
     }
     // Update node name and type
-    node->mName = sym->mUniqueName;
-    node->mType = sym->mTypeName;
+    node->mName = mCompilationUnit->mArena.CopyString(sym->mUniqueName);
+    node->mType = GetTypeID(sym->mTypeName);
+    node->mSymbol = sym;
 
     if (node->mExpression != nullptr)
     {
         VisitExpression(node->mExpression);
         if (node->mExpression->mValueType != node->mType)
         {
-            LOG_ERROR() << "Type mismatch in variable definition: " << node->mType << " " << node->mName << " and " << node->mExpression->mValueType;
+            LOG_ERROR() << "Type mismatch in variable definition: " << GetTypeName(node->mType) << " " << node->mName << " and " << GetTypeName(node->mExpression->mValueType);
             OnError();
         }
     }
@@ -291,7 +307,7 @@ Symbol* Analyser::VisitStatementNode(Statement* node)
             OnError();
         }
         else
-            retStm->mFunction = mCurrentScope->mOwningSymbol->mUniqueName;
+            retStm->mFunction = mCurrentScope->mOwningSymbol;
 
         if (retStm->mExpression != nullptr)
             VisitExpression(retStm->mExpression);
@@ -317,7 +333,8 @@ void Analyser::VisitInlineAssemblyNode(InlineAssemblyStatement* node)
         Symbol* varSym = GetSymbol(node->mOp1, ESymbolType::Variable);
         if (varSym != nullptr)
         {
-            node->mOp1 = varSym->mUniqueName;
+            node->mOp1 = mCompilationUnit->mArena.CopyString(varSym->mUniqueName);
+            node->mOp1Symbol = varSym;
         }
     }
 }
@@ -334,21 +351,31 @@ void Analyser::VisitExpression(Expression* node)
         VisitExpression(binOpExpr->mRightOperand);
         if (binOpExpr->mLeftOperand->mValueType != binOpExpr->mRightOperand->mValueType)
         {
-            LOG_ERROR() << "Binary operation expression type mismatch: " << binOpExpr->mLeftOperand->mValueType << binOpExpr->mOperator << binOpExpr->mRightOperand->mValueType;
+            LOG_ERROR() << "Binary operation expression type mismatch: " << GetTypeName(binOpExpr->mLeftOperand->mValueType) << GetOperatorString(binOpExpr->mOperator) << GetTypeName(binOpExpr->mRightOperand->mValueType);
             OnError();
         }
         else
+        {
             node->mValueType = binOpExpr->mLeftOperand->mValueType;
+            node->mValueTypeSymbol = binOpExpr->mLeftOperand->mValueTypeSymbol;
+        }
         break;
     }
     case EExpressionType::FunctionCall:
     {
         FunctionCallExpression* funcCallExpr = (FunctionCallExpression*)node;
         Symbol* funcSym = GetSymbol(funcCallExpr->mFunction, ESymbolType::Function);
-        funcCallExpr->mFunction = funcSym->mUniqueName;
+        if (funcSym == nullptr)
+        {
+            LOG_ERROR() << "Undeclared function: " << funcCallExpr->mFunction;
+            OnError();
+            break;
+        }
+        funcCallExpr->mFunction = mCompilationUnit->mArena.CopyString(funcSym->mUniqueName);
+        funcCallExpr->mFunctionSymbol = funcSym;
 
         Expression* currParamExpr = funcCallExpr->mParameters;
-        Symbol* currParamSym = funcSym->mChildren ? funcSym->mChildren->mTail : nullptr;
+        Symbol* currParamSym = funcSym->mChildren ? funcSym->mChildren->mHead : nullptr;
         while(currParamExpr != nullptr)
         {
             if (currParamSym == nullptr || currParamSym->mSymbolType != ESymbolType::FuncParam)
@@ -360,9 +387,9 @@ void Analyser::VisitExpression(Expression* node)
             // Visit expression node
             VisitExpression(static_cast<Expression*>(currParamExpr));
             // Check param value type
-            if (currParamExpr->mValueType != currParamSym->mTypeName)
+            if (currParamExpr->mValueType != GetTypeID(currParamSym->mTypeName))
             {
-                LOG_ERROR() << "Function call parameter type mismatch: " << currParamExpr->mValueType << " and " << currParamSym->mTypeName;
+                LOG_ERROR() << "Function call parameter type mismatch: " << GetTypeName(currParamExpr->mValueType) << " and " << currParamSym->mTypeName;
                 OnError();
                 break;
             }
@@ -371,7 +398,8 @@ void Analyser::VisitExpression(Expression* node)
             currParamSym = currParamSym->mNext;
         }
         
-        node->mValueType = funcSym->mTypeName;
+        node->mValueType = GetTypeID(funcSym->mTypeName);
+        node->mValueTypeSymbol = funcSym->mTypeSymbol;
 
         break;
     }
@@ -387,8 +415,10 @@ void Analyser::VisitExpression(Expression* node)
         }
         else
         {
-            identExpr->mIdentifier = identSym->mUniqueName;
-            node->mValueType = identExpr->mValueType = identSym->mTypeName;
+            identExpr->mIdentifier = mCompilationUnit->mArena.CopyString(identSym->mUniqueName);
+            identExpr->mSymbol = identSym;
+            node->mValueType = GetTypeID(identSym->mTypeName);
+            node->mValueTypeSymbol = identSym->mTypeSymbol;
         }
 
         break;
@@ -397,7 +427,10 @@ void Analyser::VisitExpression(Expression* node)
     {
         LiteralExpression* litExpr = (LiteralExpression*)node;
         if (litExpr->mToken.mTokenType == ETokenType::IntegerLiteral)
-            node->mValueType = litExpr->mValueType = "uint8_t";
+        {
+            node->mValueType = mUInt8TypeID;
+            node->mValueTypeSymbol = mUInt8TypeSymbol;
+        }
         else
         {
             LOG_ERROR() << "Invalid literal type: " << litExpr->mToken.mTokenString; // TODO
@@ -462,7 +495,7 @@ void Analyser::RegisterSymbolRecursive(Symbol* sym)
 
     if (sym->mChildren != nullptr)
     {
-        Symbol* currSym = sym->mChildren->mTail;
+        Symbol* currSym = sym->mChildren->mHead;
         while (currSym != nullptr)
         {
             RegisterSymbolRecursive(currSym);
@@ -483,7 +516,7 @@ void Analyser::Analyse()
         currNode = currNode->mNext;
     }
 
-    Symbol* currSym = mSymbolList->mTail;
+    Symbol* currSym = mSymbolList->mHead;
     while (currSym != nullptr)
     {
         RegisterSymbolRecursive(currSym);
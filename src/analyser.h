@@ -4,9 +4,8 @@
 #include "compilation_unit.h"
 #include "node.h"
 #include <unordered_map>
-#include <set>
 #include <stack>
-#include "compilation_unit.h"
+#include "symbol_table.h"
 
 class Analyser
 {
@@ -14,17 +13,25 @@ private:
     CompilationUnit* mCompilationUnit;
     SymbolList* mSymbolList;
     SymbolList* mCurrentScope;
-    std::set<std::string> mBuiltInTypes;
+    ScopedSymbolTable mScopedSymbols;
     bool mFailed = false;
+    IdentifierID mUInt8TypeID;
+    Symbol* mUInt8TypeSymbol;
 
     bool IsTypeIdentifier(const char* inTokenString);
-    Symbol* GetSymbol(const std::string& symbolName, ESymbolType symbolType);
+    Symbol* GetSymbol(std::string_view symbolName, ESymbolType symbolType);
     void PushSybolStack(Symbol* symbol);
     void PopSybolStack();
     void AddSymbol(Symbol* symbol);
     
+    // Types are stored in nodes as interned type names
+    IdentifierID GetTypeID(std::string_view typeName);
+    std::string_view GetTypeName(IdentifierID typeID);
+
     void GenerateUniqueName(Symbol* sym);
-    bool ConvertTypeName(const std::string& typeName, std::string& outUniqueName);
+    Symbol* AddBuiltInType(const char* typeName, uint16_t size);
+    // Sets the type (symbol and unique name) of a variable or function symbol
+    bool ResolveType(Symbol* sym, IdentifierID typeID);
 
     Symbol* VisitBlockNode(Block* node);
     Symbol* VisitStructDefNode(StructDefinition* node);
@@ -0,0 +1,20 @@
+#include "arena.h"
+#include <cstring>
+
+void Arena::AllocateBlock(size_t minSize)
+{
+    // Large allocations get a block of their own
+    const size_t blockSize = minSize > BlockSize ? minSize : BlockSize;
+    mBlocks.push_back(std::unique_ptr<char[]>(new char[blockSize]));
+    mCurrent = mBlocks.back().get();
+    mEnd = mCurrent + blockSize;
+}
+
+std::string_view Arena::CopyString(std::string_view str)
+{
+    if (str.empty())
+        return std::string_view();
+    char* data = static_cast<char*>(Allocate(str.size(), 1));
+    memcpy(data, str.data(), str.size());
+    return std::string_view(data, str.size());
+}
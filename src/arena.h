@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <new>
+#include <stdint.h>
+
+/**
+* Bump allocator, for data that lives as long as its owner (such as the AST nodes of a CompilationUnit and their strings).
+* Memory is taken from large blocks, and all of it is released at once when the arena is destroyed.
+* Destructors of the allocated objects are never called.
+*/
+class Arena
+{
+private:
+    static const size_t BlockSize = 64 * 1024;
+
+    std::vector<std::unique_ptr<char[]>> mBlocks;
+    char* mCurrent = nullptr;
+    char* mEnd = nullptr;
+
+    void AllocateBlock(size_t minSize);
+
+public:
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* Allocate(size_t size, size_t alignment)
+    {
+        uintptr_t address = (reinterpret_cast<uintptr_t>(mCurrent) + alignment - 1) & ~(alignment - 1);
+        if (mCurrent == nullptr || address + size > reinterpret_cast<uintptr_t>(mEnd))
+        {
+            AllocateBlock(size + alignment);
+            address = (reinterpret_cast<uintptr_t>(mCurrent) + alignment - 1) & ~(alignment - 1);
+        }
+        mCurrent = reinterpret_cast<char*>(address + size);
+        return reinterpret_cast<void*>(address);
+    }
+
+    template<typename T, typename... Args>
+    T* New(Args&&... args)
+    {
+        return new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // Copies the string into the arena
+    std::string_view CopyString(std::string_view str);
+};
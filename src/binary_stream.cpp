@@ -0,0 +1,36 @@
+#include "binary_stream.h"
+#include <fstream>
+#include <filesystem>
+#include <thread>
+#include <functional>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+bool BinaryWriter::WriteToFile(const std::string& path) const
+{
+    // Unique per process and thread, so concurrent writers of the same file never share a temp file
+    const size_t threadHash = std::hash<std::thread::id>()(std::this_thread::get_id());
+    const std::string tempPath = path + ".tmp" + std::to_string(getpid()) + "_" + std::to_string(threadHash);
+    {
+        std::ofstream fileStream(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!fileStream)
+            return false;
+        fileStream.write(mData.data(), mData.size());
+        if (!fileStream)
+            return false;
+    }
+
+    std::error_code errorCode;
+    std::filesystem::rename(tempPath, path, errorCode);
+    if (errorCode)
+    {
+        std::filesystem::remove(tempPath, errorCode);
+        return false;
+    }
+    return true;
+}
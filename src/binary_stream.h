@@ -0,0 +1,98 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstring>
+#include <stdint.h>
+#include <type_traits>
+
+/**
+* Writes binary data (little-endian, as laid out in memory) to a buffer.
+*/
+class BinaryWriter
+{
+private:
+    std::vector<char> mData;
+
+public:
+    template <typename T>
+    void Write(const T& value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "BinaryWriter::Write requires a trivially copyable type");
+        WriteBytes(&value, sizeof(T));
+    }
+
+    void WriteBytes(const void* data, size_t size)
+    {
+        const char* bytes = static_cast<const char*>(data);
+        mData.insert(mData.end(), bytes, bytes + size);
+    }
+
+    void WriteString(std::string_view str)
+    {
+        Write<uint32_t>(static_cast<uint32_t>(str.size()));
+        WriteBytes(str.data(), str.size());
+    }
+
+    const std::vector<char>& GetData() const { return mData; }
+
+    // Writes to a temporary file first, so readers never see a partially written file.
+    bool WriteToFile(const std::string& path) const;
+};
+
+/**
+* Reads binary data written by BinaryWriter.
+* Reading past the end sets the failed flag, and returns zeroed values.
+*/
+class BinaryReader
+{
+private:
+    const char* mPos;
+    const char* mEnd;
+    bool mFailed = false;
+
+public:
+    BinaryReader(const char* data, size_t size)
+        : mPos(data), mEnd(data + size)
+    {
+    }
+
+    template <typename T>
+    T Read()
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "BinaryReader::Read requires a trivially copyable type");
+        T value{};
+        ReadBytes(&value, sizeof(T));
+        return value;
+    }
+
+    void ReadBytes(void* outData, size_t size)
+    {
+        if (mFailed || static_cast<size_t>(mEnd - mPos) < size)
+        {
+            mFailed = true;
+            memset(outData, 0, size);
+            return;
+        }
+        memcpy(outData, mPos, size);
+        mPos += size;
+    }
+
+    // Returns a view into the read buffer
+    std::string_view ReadString()
+    {
+        const uint32_t size = Read<uint32_t>();
+        if (mFailed || static_cast<size_t>(mEnd - mPos) < size)
+        {
+            mFailed = true;
+            return std::string_view();
+        }
+        std::string_view str(mPos, size);
+        mPos += size;
+        return str;
+    }
+
+    bool HasFailed() const { return mFailed; }
+    bool IsAtEnd() const { return mPos == mEnd; }
+};
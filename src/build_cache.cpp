@@ -0,0 +1,63 @@
+#include "build_cache.h"
+#include "object_file.h"
+#include "hash.h"
+#include <filesystem>
+#include <cstdio>
+
+namespace
+{
+    // Bump when code generation changes, so stale objects are not reused
+    const char CompilerVersion[] = "CNES 8";
+}
+
+BuildCache::BuildCache(const std::string& directory)
+    : mDirectory(directory), mNumHits(0), mNumMisses(0)
+{
+    std::error_code errorCode;
+    std::filesystem::create_directories(mDirectory, errorCode);
+}
+
+std::string BuildCache::GetObjectPath(uint64_t key) const
+{
+    char fileName[32];
+    snprintf(fileName, sizeof(fileName), "%016llx.o", static_cast<unsigned long long>(key));
+    return (std::filesystem::path(mDirectory) / fileName).string();
+}
+
+uint64_t BuildCache::GetKey(const std::vector<Token>& tokens, uint16_t zeroPageBudget)
+{
+    // Line numbers are left out: they don't change the code
+    uint64_t hash = HashFNV1a(CompilerVersion, sizeof(CompilerVersion));
+    hash = HashFNV1a(&zeroPageBudget, sizeof(zeroPageBudget), hash);
+    for (const Token& token : tokens)
+    {
+        const uint8_t tokenType = static_cast<uint8_t>(token.mTokenType);
+        const uint32_t size = static_cast<uint32_t>(token.mTokenString.size());
+        hash = HashFNV1a(&tokenType, sizeof(tokenType), hash);
+        hash = HashFNV1a(&size, sizeof(size), hash);
+        hash = HashFNV1a(token.mTokenString.data(), token.mTokenString.size(), hash);
+    }
+    return hash;
+}
+
+bool BuildCache::Load(uint64_t key, CompilationUnit* compUnit)
+{
+    if (!ObjectFile::Read(GetObjectPath(key), compUnit))
+    {
+        // Drop whatever was read before the object turned out to be missing or invalid
+        compUnit->mObjectCode.clear();
+        compUnit->mSymbolTable.clear();
+        compUnit->mRelocationText = RelocationText();
+        mNumMisses++;
+        return false;
+    }
+    mNumHits++;
+    return true;
+}
+
+void BuildCache::Store(uint64_t key, const CompilationUnit* compUnit)
+{
+    const std::string objectPath = GetObjectPath(key);
+    if (!ObjectFile::Write(objectPath, compUnit))
+        printf("Failed to write to build cache: %s\n", objectPath.c_str());
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include "tokeniser.h"
+#include "compilation_unit.h"
+
+/**
+* Cache of compiled units (object files), keyed by a hash of the preprocessed tokens, the code generation options
+*  and the compiler version.
+* A unit whose preprocessed tokens are unchanged is loaded from the cache instead of being parsed, analysed and generated.
+* Safe to use from several threads.
+*/
+class BuildCache
+{
+private:
+    std::string mDirectory;
+    std::atomic<size_t> mNumHits;
+    std::atomic<size_t> mNumMisses;
+
+    std::string GetObjectPath(uint64_t key) const;
+
+public:
+    BuildCache(const std::string& directory);
+
+    static uint64_t GetKey(const std::vector<Token>& tokens, uint16_t zeroPageBudget);
+
+    // Returns false on a miss
+    bool Load(uint64_t key, CompilationUnit* compUnit);
+    void Store(uint64_t key, const CompilationUnit* compUnit);
+
+    size_t GetNumHits() const { return mNumHits; }
+    size_t GetNumMisses() const { return mNumMisses; }
+};
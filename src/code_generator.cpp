@@ -5,38 +5,74 @@
 #include <cstring>
 #include <exception>
 
-uint16_t DataAllocator::RequestVarAddr(uint16_t bytes)
+bool EmitOperand::operator==(const EmitOperand& other) const
 {
-    // Avoid collision with the stack
-    if (mNextVarAddr + bytes >= 0x0100)
-        mNextVarAddr = 0x0200;
+    if (mType != other.mType)
+        return false;
+    switch (mType)
+    {
+    case EOperandType::None:
+        return true;
+    case EOperandType::Value:
+        return mValue == other.mValue;
+    case EOperandType::Register:
+        return mRegister == other.mRegister;
+    default:
+        return mAddress == other.mAddress && mRelativeSymbol == other.mRelativeSymbol;
+    }
+}
+
+bool RegisterState::Contains(EProcReg reg, const EmitOperand& operand) const
+{
+    const std::vector<EmitOperand>& values = mValues[static_cast<int>(reg)];
+    return std::find(values.begin(), values.end(), operand) != values.end();
+}
 
-    const uint16_t addr = mNextVarAddr;
-    mNextVarAddr += bytes;
+void RegisterState::OnLoad(EProcReg reg, const EmitOperand& operand)
+{
+    OnModified(reg);
+    mValues[static_cast<int>(reg)].push_back(operand);
+    mFlagsValid[static_cast<int>(reg)] = true;
+}
 
-    assert(mNextVarAddr <= 0x0800); // End of 2KB internal RAM
+void RegisterState::OnStore(EProcReg reg, const EmitOperand& location)
+{
+    // The old value of the location is gone from every register
+    for (std::vector<EmitOperand>& values : mValues)
+        values.erase(std::remove(values.begin(), values.end(), location), values.end());
+    mValues[static_cast<int>(reg)].push_back(location);
+}
 
-    return addr;
+void RegisterState::OnModified(EProcReg reg)
+{
+    mValues[static_cast<int>(reg)].clear();
+    OnFlagsModified();
+    mFlagsValid[static_cast<int>(reg)] = true;
+}
+
+void RegisterState::OnFlagsModified()
+{
+    for (bool& flagsValid : mFlagsValid)
+        flagsValid = false;
 }
 
-void CodeGenerator::CacheRegisterContent(EProcReg reg, EmitOperand val)
+void RegisterState::OnFlagsSet(EProcReg reg)
 {
-    // TODO: Allow caching more than one operand.
-    // example case:
-    // LDA #1
-    // STA $0000
-    // STA $0001 => #1 == $0000 == $0001
-    mRegisterContent[reg] = val;
+    OnFlagsModified();
+    mFlagsValid[static_cast<int>(reg)] = true;
 }
 
-bool CodeGenerator::RegisterContains(EProcReg reg, EmitOperand val)
+void RegisterState::OnTransfer(EProcReg src, EProcReg dst)
 {
-    return (memcmp(&mRegisterContent[reg], &val, sizeof(EmitOperand)) == 0);
+    mValues[static_cast<int>(dst)] = mValues[static_cast<int>(src)];
+    OnFlagsSet(dst);
 }
 
-void CodeGenerator::ClearRegisterContentCache(EProcReg reg)
+void RegisterState::Clear()
 {
-    mRegisterContent[reg] = EmitOperand();
+    for (std::vector<EmitOperand>& values : mValues)
+        values.clear();
+    OnFlagsModified();
 }
 
 const char* CodeGenerator::GetLoadOpcode(const EProcReg reg)
@@ -108,62 +144,331 @@ const char* CodeGenerator::GetBranchOp(const EBranchType type)
     }
 }
 
-CodeGenerator::CodeGenerator(CompilationUnit* compilationUnit, Emitter* emitter, DataAllocator* dataAllocator)
+CodeGenerator::CodeGenerator(CompilationUnit* compilationUnit, Emitter* emitter, uint16_t zeroPageBudget)
 {
     mCompilationUnit = compilationUnit;
     mEmitter = emitter;
-    mDataAllocator = dataAllocator;
+    mZeroPageBytesLeft = zeroPageBudget;
+
+    mUInt8TypeID = mCompilationUnit->mIdentifierTable->Intern("uint8_t");
+    mVoidTypeID = mCompilationUnit->mIdentifierTable->Intern("void");
+}
+
+static uint32_t AddWeights(uint32_t a, uint32_t b)
+{
+    return a > UINT32_MAX - b ? UINT32_MAX : a + b;
+}
+
+// Code in a loop is assumed to run 8 times per run of the code around it
+static uint32_t GetLoopWeight(uint32_t weight)
+{
+    return weight > UINT32_MAX / 8 ? UINT32_MAX : weight * 8;
+}
+
+void CodeGenerator::AddAccess(const Symbol* sym, uint32_t weight)
+{
+    if (sym == nullptr || (sym->mSymbolType != ESymbolType::Variable && sym->mSymbolType != ESymbolType::FuncParam))
+        return;
+
+    auto weightIter = mAccessWeights.find(sym);
+    if (weightIter == mAccessWeights.end())
+    {
+        mAccessWeights[sym] = weight;
+        mAccessedSymbols.push_back(sym);
+    }
+    else
+        weightIter->second = AddWeights(weightIter->second, weight);
+}
+
+void CodeGenerator::CountAccesses(Expression* expr, uint32_t weight)
+{
+    switch (expr->GetExpressionType())
+    {
+    case EExpressionType::Identifier:
+        AddAccess(static_cast<IdentifierExpression*>(expr)->mSymbol, weight);
+        break;
+    case EExpressionType::FunctionCall:
+    {
+        // Each argument is stored to its parameter
+        FunctionCallExpression* callExpr = static_cast<FunctionCallExpression*>(expr);
+        Symbol* funcSym = callExpr->mFunctionSymbol;
+        Symbol* paramSym = funcSym != nullptr && funcSym->mChildren ? funcSym->mChildren->mHead : nullptr;
+        for (Expression* paramExpr = callExpr->mParameters; paramExpr != nullptr; paramExpr = static_cast<Expression*>(paramExpr->mNext))
+        {
+            CountAccesses(paramExpr, weight);
+            AddAccess(paramSym, weight);
+            paramSym = paramSym != nullptr ? paramSym->mNext : nullptr;
+        }
+        break;
+    }
+    case EExpressionType::BinaryOperation:
+    {
+        BinaryOperationExpression* binOpExpr = static_cast<BinaryOperationExpression*>(expr);
+        CountAccesses(binOpExpr->mLeftOperand, weight);
+        CountAccesses(binOpExpr->mRightOperand, weight);
+        break;
+    }
+    case EExpressionType::UnaryOperation:
+        CountAccesses(static_cast<UnaryOperationExpression*>(expr)->mOperand, weight);
+        break;
+    default:
+        break;
+    }
+}
+
+void CodeGenerator::CountAccesses(Node* node, uint32_t weight)
+{
+    switch (node->GetNodeType())
+    {
+    case ENodeType::FunctionDefinition:
+    {
+        FunctionDefinition* funcDef = static_cast<FunctionDefinition*>(node);
+        for (Node* currContent = funcDef->mContent; currContent != nullptr; currContent = currContent->mNext)
+            CountAccesses(currContent, weight);
+        break;
+    }
+    case ENodeType::StructDefinition:
+    {
+        StructDefinition* structDef = static_cast<StructDefinition*>(node);
+        for (Node* currContent = structDef->mContent; currContent != nullptr; currContent = currContent->mNext)
+            CountAccesses(currContent, weight);
+        break;
+    }
+    case ENodeType::Block:
+        for (Node* currNode = static_cast<Block*>(node)->mNode; currNode != nullptr; currNode = currNode->mNext)
+            CountAccesses(currNode, weight);
+        break;
+    case ENodeType::InlineAssembly:
+        AddAccess(static_cast<InlineAssemblyStatement*>(node)->mOp1Symbol, weight);
+        break;
+    case ENodeType::Statement:
+    {
+        Statement* statement = static_cast<Statement*>(node);
+        switch (statement->GetStatementType())
+        {
+        case EStatementType::VariableDefinition:
+        {
+            VarDefStatement* varDefStm = static_cast<VarDefStatement*>(statement);
+            if (varDefStm->mExpression != nullptr)
+            {
+                CountAccesses(varDefStm->mExpression, weight);
+                AddAccess(varDefStm->mSymbol, weight);
+            }
+            break;
+        }
+        case EStatementType::ControlStatement:
+        {
+            ControlStatement* controlStm = static_cast<ControlStatement*>(statement);
+            if (controlStm->mControlStatementType == ControlStatement::EControlStatementType::While)
+                weight = GetLoopWeight(weight);
+            CountAccesses(controlStm->mExpression, weight);
+            CountAccesses(controlStm->mBody, weight);
+            if (controlStm->mConnectedStatement != nullptr)
+                CountAccesses(controlStm->mConnectedStatement, weight);
+            break;
+        }
+        case EStatementType::ReturnStatement:
+        {
+            ReturnStatement* retStm = static_cast<ReturnStatement*>(statement);
+            if (retStm->mExpression != nullptr)
+                CountAccesses(retStm->mExpression, weight);
+            break;
+        }
+        case EStatementType::Expression:
+            CountAccesses(static_cast<ExpressionStatement*>(statement)->mExpression, weight);
+            break;
+        default:
+            break;
+        }
+        break;
+    }
+    case ENodeType::Expression:
+        break; // counted through the statement that contains it
+    }
+}
+
+void CodeGenerator::ChooseZeroPageSymbols()
+{
+    // Hottest first. Ties keep the order of first access, so the choice is deterministic.
+    std::vector<const Symbol*> symbols = mAccessedSymbols;
+    std::stable_sort(symbols.begin(), symbols.end(),
+        [this](const Symbol* a, const Symbol* b) { return mAccessWeights[a] > mAccessWeights[b]; });
 
-    mRegisterContent[EProcReg::A] = EmitOperand();
-    mRegisterContent[EProcReg::X] = EmitOperand();
-    mRegisterContent[EProcReg::Y] = EmitOperand();
+    for (const Symbol* sym : symbols)
+    {
+        const uint16_t size = sym->mTypeSymbol != nullptr ? sym->mTypeSymbol->mSize : sym->mSize;
+        if (size > 0 && size <= mZeroPageBytesLeft)
+        {
+            mZeroPageSymbols.insert(sym);
+            mZeroPageBytesLeft -= size;
+        }
+    }
+}
 
-    // Register built-in types
-    RegisterBuiltinSymbol("uint8_t", 1);
+bool CodeGenerator::IsZeroPageSymbol(const Symbol* sym) const
+{
+    // Only once this unit has placed it: other symbols are relocated by name, with absolute addressing
+    return sym->mAddrType != ESymAddrType::None && mZeroPageSymbols.find(sym) != mZeroPageSymbols.end();
 }
 
-void CodeGenerator::RegisterBuiltinSymbol(std::string name, uint16_t size)
+DataSymbol* CodeGenerator::FindDataSymbol(uint16_t localAddr)
 {
-    Symbol* sym = new Symbol();
-    sym->mName = sym->mUniqueName = name;
-    sym->mSize = size;
-    sym->mSymbolType = ESymbolType::BuiltInType;
-    mCompilationUnit->mSymbolTable[name] = sym;
+    std::vector<DataSymbol>& dataSymbols = mCompilationUnit->mRelocationText.mDataSymbols;
+    auto dataSymIter = std::upper_bound(dataSymbols.begin(), dataSymbols.end(), localAddr,
+        [](uint16_t addr, const DataSymbol& dataSym) { return addr < dataSym.mLocalAddress; });
+    if (dataSymIter == dataSymbols.begin())
+        return nullptr;
+    --dataSymIter;
+    return localAddr < dataSymIter->mLocalAddress + dataSymIter->mSize ? &*dataSymIter : nullptr;
+}
+
+uint16_t CodeGenerator::AllocateData(uint16_t bytes, uint16_t alignment, bool zeroPage, uint32_t weight)
+{
+    // RAM addresses are local to the unit until the linker places the data symbols
+    DataSymbol dataSym;
+    dataSym.mLocalAddress = mDataSize;
+    dataSym.mSize = bytes;
+    dataSym.mAlignment = alignment;
+    dataSym.mZeroPage = zeroPage;
+    dataSym.mWeight = weight;
+    mCompilationUnit->mRelocationText.mDataSymbols.push_back(dataSym);
+    mDataSize += bytes;
+    return dataSym.mLocalAddress;
+}
+
+void CodeGenerator::AllocateSymbolData(Symbol* sym)
+{
+    const bool zeroPage = mZeroPageSymbols.find(sym) != mZeroPageSymbols.end();
+    auto weightIter = mAccessWeights.find(sym);
+    const uint32_t weight = weightIter != mAccessWeights.end() ? weightIter->second : 0;
+
+    sym->mAddrType = ESymAddrType::Absolute;
+    sym->mAddress = AllocateData(sym->mSize, 1, zeroPage, weight);
+}
+
+uint16_t CodeGenerator::AllocateTemp()
+{
+    uint16_t addr;
+    if (!mFreeTemps.empty())
+    {
+        addr = mFreeTemps.back();
+        mFreeTemps.pop_back();
+    }
+    else
+    {
+        // Temporaries get what is left of the zero page budget
+        const bool zeroPage = mZeroPageBytesLeft > 0;
+        if (zeroPage)
+            mZeroPageBytesLeft--;
+        addr = AllocateData(1, 1, zeroPage);
+    }
+
+    // Stored once and loaded once
+    DataSymbol* dataSym = FindDataSymbol(addr);
+    dataSym->mWeight = AddWeights(dataSym->mWeight, AddWeights(mAccessWeight, mAccessWeight));
+
+    mUsedTemps.push_back(addr);
+    return addr;
+}
+
+void CodeGenerator::ReleaseTemps(size_t usedTempsMark)
+{
+    while (mUsedTemps.size() > usedTempsMark)
+    {
+        mFreeTemps.push_back(mUsedTemps.back());
+        mUsedTemps.pop_back();
+    }
+}
+
+void CodeGenerator::ResetTemps()
+{
+    mUsedTemps.clear();
+    mFreeTemps.clear();
 }
 
 void CodeGenerator::ConvertToAddress(EmitOperand& operand)
 {
-    if (operand.mType == EOperandType::Value)
+    if (operand.mType == EOperandType::Value || operand.mType == EOperandType::Register)
     {
         EmitOperand src = operand;
-        operand.mType = EOperandType::DataAddress;
-        operand.mAddress = mDataAllocator->RequestVarAddr(1); // TODO: support more than 1 byte literals
+        operand = EmitOperand(EOperandType::DataAddress, AllocateTemp(), nullptr); // TODO: support more than 1 byte literals
         EmitStore(src, operand);
     }
 }
 
 void CodeGenerator::Emit(const char* op)
 {
-    mEmitter->Emit(op);
+    mInstructions.Add(op);
+}
+
+void CodeGenerator::Emit(const char* op, const EAddressingMode addrMode, const uint16_t value)
+{
+    mInstructions.Add(op, addrMode, value);
 }
 
 void CodeGenerator::EmitRelocatedAddress(const std::string& op, const EAddressingMode addrMode, const uint16_t operand)
 {
-    mEmitter->Emit(op.c_str(), addrMode, operand);
-    mCompilationUnit->mRelocationText.mRelativeAddresses.push_back(mEmitter->GetCurrentLocation() - 2);
+    mInstructions.Add(op.c_str(), addrMode, operand, EInstructionRelocation::CodeAddress);
+}
+
+void CodeGenerator::EmitDataAddress(const char* op, const EAddressingMode addrMode, const uint16_t addr)
+{
+    mInstructions.Add(op, addrMode, addr, EInstructionRelocation::DataAddress);
+}
+
+void CodeGenerator::EmitDataOperand(const char* op, const EmitOperand& operand)
+{
+    const Symbol* sym = operand.mRelativeSymbol;
+    if (sym != nullptr && !IsZeroPageSymbol(sym))
+    {
+        EmitRelocatedSymbol(op, EAddressingMode::Absolute, sym, operand.mAddress);
+        return;
+    }
+
+    const uint16_t localAddr = sym != nullptr ? sym->mAddress + operand.mAddress : operand.mAddress;
+    const DataSymbol* dataSym = FindDataSymbol(localAddr);
+    const bool isZeroPage = dataSym != nullptr && dataSym->mZeroPage;
+    EmitDataAddress(op, isZeroPage ? EAddressingMode::ZeroPage : EAddressingMode::Absolute, localAddr);
 }
 
 void CodeGenerator::EmitRelocatedSymbol(const std::string& op, const EAddressingMode addrMode, const Symbol* sym, const uint16_t offset)
 {
-    mEmitter->Emit(op.c_str(), addrMode, sym->mAddress + offset);
-    mCompilationUnit->mRelocationText.mSymAddrRefs.push_back({ mEmitter->GetCurrentLocation() - 2, sym->mUniqueName });
+    mInstructions.AddSymbol(op.c_str(), addrMode, sym, sym->mAddress + offset);
+}
+
+uint16_t CodeGenerator::GetCodeLocation()
+{
+    return mEmitter->GetCurrentLocation() + mInstructions.GetCodeSize(mEmitter);
+}
+
+void CodeGenerator::FlushInstructions()
+{
+    mPeephole.Optimise(mInstructions.GetInstructions());
+    mInstructions.Resolve(mEmitter, mCompilationUnit->mRelocationText);
+}
+
+
+void CodeGenerator::OnLabel()
+{
+    // Nothing is known about the paths that lead here
+    mRegisterState.Clear();
 }
 
+void CodeGenerator::EmitLabel(LabelID label)
+{
+    mInstructions.BindLabel(label);
+    OnLabel();
+}
 
-void CodeGenerator::EmitLoad(const EProcReg reg, const EmitOperand operand)
+void CodeGenerator::EmitLoad(const EProcReg reg, const EmitOperand operand, bool needFlags)
 {
-    // TODO: We need to be absolutely sure that the address has not been written to since last load
-    if (RegisterContains(reg, operand))
+    if (operand.mType == EOperandType::Register)
+    {
+        EmitTransfer(operand.mRegister, reg, needFlags);
+        return;
+    }
+
+    if (mRegisterState.Contains(reg, operand) && (!needFlags || mRegisterState.FlagsReflect(reg)))
         return;
 
     const char* op = GetLoadOpcode(reg);
@@ -174,13 +479,12 @@ void CodeGenerator::EmitLoad(const EProcReg reg, const EmitOperand operand)
         printf("ERROR: EmitLoad called with None address.\n");
         return;
     case EOperandType::Value:
-        mEmitter->Emit(op, EAddressingMode::Immediate, operand.mValue);
+        Emit(op, EAddressingMode::Immediate, operand.mValue);
+        break;
+    case EOperandType::Register:
         break;
     case EOperandType::DataAddress:
-        if (operand.mRelativeSymbol != nullptr)
-            EmitRelocatedSymbol(op, EAddressingMode::Absolute, operand.mRelativeSymbol, operand.mAddress);
-        else
-            mEmitter->Emit(op, EAddressingMode::Absolute, operand.mAddress);
+        EmitDataOperand(op, operand);
         break;
     case EOperandType::CodeAddress:
         if (operand.mRelativeSymbol != nullptr)
@@ -190,7 +494,36 @@ void CodeGenerator::EmitLoad(const EProcReg reg, const EmitOperand operand)
         break;
     }
 
-    CacheRegisterContent(reg, operand);
+    mRegisterState.OnLoad(reg, operand);
+}
+
+void CodeGenerator::EmitTransfer(const EProcReg src, const EProcReg dst, bool needFlags)
+{
+    if (src == dst)
+    {
+        if (needFlags && !mRegisterState.FlagsReflect(dst))
+        {
+            // Set N and Z without changing the register
+            if (dst == EProcReg::A)
+                EmitAcumulatorArithmetic(EAccumulatorArithmeticOp::AND, EmitOperand(EOperandType::Value, 0xFF, nullptr));
+            else
+                EmitCompare(dst, EmitOperand(EOperandType::Value, 0, nullptr));
+            mRegisterState.OnFlagsSet(dst);
+        }
+        return;
+    }
+
+    if (src == EProcReg::A)
+        Emit(dst == EProcReg::X ? "TAX" : "TAY");
+    else if (dst == EProcReg::A)
+        Emit(src == EProcReg::X ? "TXA" : "TYA");
+    else
+    {
+        printf("ERROR: No transfer instruction between X and Y.\n");
+        return;
+    }
+
+    mRegisterState.OnTransfer(src, dst);
 }
 
 void CodeGenerator::EmitStore(const EProcReg reg, const EmitOperand operand)
@@ -205,11 +538,11 @@ void CodeGenerator::EmitStore(const EProcReg reg, const EmitOperand operand)
     case EOperandType::Value:
         printf("ERROR: EmitStore called with Value operand. STA/STX/STY must be called with memory address.\n");
         return;
+    case EOperandType::Register:
+        printf("ERROR: EmitStore called with Register operand. STA/STX/STY must be called with memory address.\n");
+        return;
     case EOperandType::DataAddress:
-        if (operand.mRelativeSymbol != nullptr)
-            EmitRelocatedSymbol(op, EAddressingMode::Absolute, operand.mRelativeSymbol, operand.mAddress);
-        else
-            mEmitter->Emit(op, EAddressingMode::Absolute, operand.mAddress);
+        EmitDataOperand(op, operand);
         break;
     case EOperandType::CodeAddress:
         if (operand.mRelativeSymbol != nullptr)
@@ -219,8 +552,7 @@ void CodeGenerator::EmitStore(const EProcReg reg, const EmitOperand operand)
         break;
     }
 
-    if (RegisterContains(reg, operand))
-        ClearRegisterContentCache(reg);
+    mRegisterState.OnStore(reg, operand);
 }
 
 void CodeGenerator::EmitStore(const EmitOperand src, const EmitOperand dst)
@@ -229,33 +561,17 @@ void CodeGenerator::EmitStore(const EmitOperand src, const EmitOperand dst)
     EmitStore(EProcReg::A, dst);
 }
 
-void CodeGenerator::EmitBranch(EBranchType type, int8_t offset)
+void CodeGenerator::EmitBranch(EBranchType type, LabelID label)
 {
-    const char* op = GetBranchOp(type);
-
-    const uint8_t absOffset = static_cast<uint8_t>(abs(offset));
-    if (absOffset > 127)
-    {
-        printf("ERROR: Control statement body too large. Max displacement exceeded.\n");
-        return;
-    }
-
-    const uint8_t displacement = (offset >= 0) ? (absOffset) : (absOffset | 0b10000000); // absolute offset, with first bit as sign bit
-    mEmitter->Emit(op, EAddressingMode::Immediate, displacement);
-}
-
-void CodeGenerator::EmitBranchAt(EBranchType type, uint8_t offset, uint16_t branchCodeAddr)
-{
-    uint16_t emitterLoc = mEmitter->GetCurrentLocation();
-    mEmitter->SetWritePos(branchCodeAddr);
-    EmitBranch(type, offset);
-    mEmitter->SetWritePos(emitterLoc);
+    mInstructions.AddLabel(GetBranchOp(type), EAddressingMode::Immediate, label);
 }
 
 void CodeGenerator::EmitCompare(EProcReg reg, EmitOperand operand1, EmitOperand operand2)
 {
     // If content of second operand is already in register, swap the parameters
-    if (memcmp(&mRegisterContent[reg], &operand2, sizeof(EmitOperand)) == 0)
+    const bool operand1InReg = operand1.mType == EOperandType::Register || mRegisterState.Contains(reg, operand1);
+    const bool operand2InReg = operand2.mType == EOperandType::Register || mRegisterState.Contains(reg, operand2);
+    if (operand2InReg && !operand1InReg)
     {
         EmitCompare(reg, operand2, operand1);
         return;
@@ -277,19 +593,22 @@ void CodeGenerator::EmitCompare(EProcReg reg, EmitOperand operand)
         assert(0);
         return;
     case EOperandType::Value:
-        mEmitter->Emit(op, EAddressingMode::Immediate, operand.mValue);
-        return;
+        Emit(op, EAddressingMode::Immediate, operand.mValue);
+        break;
     case EOperandType::DataAddress:
-        if (operand.mRelativeSymbol != nullptr)
-            EmitRelocatedSymbol(op, EAddressingMode::Absolute, operand.mRelativeSymbol, operand.mAddress);
-        else
-            mEmitter->Emit(op, EAddressingMode::Absolute, operand.mAddress);
+        EmitDataOperand(op, operand);
         break;
     case EOperandType::CodeAddress:
         printf("ERROR: EmitCompare called with Code address. Why would you do that?\n");
         assert(0);
         break;
+    case EOperandType::Register:
+        printf("ERROR: EmitCompare called with Register operand. It must be called with memory address or immediate value.\n");
+        assert(0);
+        return;
     }
+
+    mRegisterState.OnFlagsModified();
 }
 
 void CodeGenerator::EmitAcumulatorArithmetic(EAccumulatorArithmeticOp op, EmitOperand operand)
@@ -303,22 +622,23 @@ void CodeGenerator::EmitAcumulatorArithmetic(EAccumulatorArithmeticOp op, EmitOp
         assert(0);
         return;
     case EOperandType::Value:
-        mEmitter->Emit(opString, EAddressingMode::Immediate, operand.mValue);
-        return;
+        Emit(opString, EAddressingMode::Immediate, operand.mValue);
+        break;
     case EOperandType::DataAddress:
-        if (operand.mRelativeSymbol != nullptr)
-            EmitRelocatedSymbol(opString, EAddressingMode::Absolute, operand.mRelativeSymbol, operand.mAddress);
-        else
-            mEmitter->Emit(opString, EAddressingMode::Absolute, operand.mAddress);
+        EmitDataOperand(opString, operand);
         break;
     case EOperandType::CodeAddress:
         printf("ERROR: EmitAcumulatorArithmetic called with Code address. Why would you do that?\n");
         assert(0);
         break;
+    case EOperandType::Register:
+        printf("ERROR: EmitAcumulatorArithmetic called with Register operand.\n");
+        assert(0);
+        return;
     }
 
-    // Clear register content
-    ClearRegisterContentCache(EProcReg::A);
+    // A holds the result now
+    mRegisterState.OnModified(EProcReg::A);
 }
 
 void CodeGenerator::EmitJump(EJumpType type, EmitOperand operand)
@@ -332,6 +652,18 @@ void CodeGenerator::EmitJump(EJumpType type, EmitOperand operand)
         EmitRelocatedSymbol(op, EAddressingMode::Absolute, operand.mRelativeSymbol, operand.mAddress);
     else
         EmitRelocatedAddress(op, EAddressingMode::Absolute, operand.mAddress);
+
+    // The callee may change any register and any memory
+    if (type == EJumpType::JSR)
+        mRegisterState.Clear();
+}
+
+void CodeGenerator::EmitJump(EJumpType type, LabelID label)
+{
+    mInstructions.AddLabel(type == EJumpType::JMP ? "JMP" : "JSR", EAddressingMode::Absolute, label);
+
+    if (type == EJumpType::JSR)
+        mRegisterState.Clear();
 }
 
 void CodeGenerator::SetIdentifierSymSize(Symbol* sym)
@@ -342,8 +674,7 @@ void CodeGenerator::SetIdentifierSymSize(Symbol* sym)
     case ESymbolType::Variable:
     case ESymbolType::FuncParam:
     {
-        Symbol* typeSym = mCompilationUnit->mSymbolTable[sym->mTypeName];
-        sym->mSize = typeSym->mSize;
+        sym->mSize = sym->mTypeSymbol->mSize;
         break;
     }
     default:
@@ -355,7 +686,7 @@ EmitOperand CodeGenerator::EmitLiteralExpression(LiteralExpression* litExpr)
 {
     if (litExpr->mToken.mTokenType == ETokenType::IntegerLiteral)
     {
-        assert(litExpr->mValueType == "uint8_t");
+        assert(litExpr->mValueType == mUInt8TypeID);
         uint8_t val = static_cast<uint8_t>(litExpr->mToken.mIntValue);
         EmitOperand emitRes;
         emitRes.mType = EOperandType::Value;
@@ -368,16 +699,15 @@ EmitOperand CodeGenerator::EmitLiteralExpression(LiteralExpression* litExpr)
 
 EmitOperand CodeGenerator::EmitIdentifierExpression(IdentifierExpression* identExpr)
 {
-    Symbol* identSym = mCompilationUnit->mSymbolTable[identExpr->mIdentifier];
-    return EmitOperand(EOperandType::DataAddress, 0, identSym);
+    return EmitOperand(EOperandType::DataAddress, 0, identExpr->mSymbol);
 }
 
 EmitOperand CodeGenerator::EmitFuncCallExpression(FunctionCallExpression* callExrp)
 {
-    Symbol* funcSym = mCompilationUnit->mSymbolTable[callExrp->mFunction];
+    Symbol* funcSym = callExrp->mFunctionSymbol;
 
     // Set parameters
-    Symbol* paramSym = funcSym->mChildren ? funcSym->mChildren->mTail : nullptr;
+    Symbol* paramSym = funcSym->mChildren ? funcSym->mChildren->mHead : nullptr;
     Expression* paramExpr = callExrp->mParameters;
     while (paramExpr != nullptr)
     {
@@ -416,12 +746,8 @@ EmitOperand CodeGenerator::EmitFuncCallExpression(FunctionCallExpression* callEx
     EmitJump(EJumpType::JSR, jmpAddr);
 
     // Return value
-    if (funcSym->mTypeName != "void")
-    {
-        EmitOperand funcRetAddr = mFuncRetAddrs[funcSym->mUniqueName];
-
-        return funcRetAddr;
-    }
+    if (funcSym->mTypeSymbol->mNameID != mVoidTypeID)
+        return EmitOperand(EProcReg::A);
     else
     {
         EmitOperand voidAddr;
@@ -432,59 +758,58 @@ EmitOperand CodeGenerator::EmitFuncCallExpression(FunctionCallExpression* callEx
 
 EmitOperand CodeGenerator::EmitBinOpExpression(BinaryOperationExpression* binOpExpr)
 {
-    Symbol* valSym = mCompilationUnit->mSymbolTable[binOpExpr->mValueType];
-
-    EmitOperand retAddr;
-    retAddr.mType = EOperandType::DataAddress;
-    retAddr.mAddress = mDataAllocator->RequestVarAddr(valSym->mSize);
+    EmitOperand retAddr(EProcReg::A);
 
     EmitOperand leftExprAddr = EmitExpression(binOpExpr->mLeftOperand);
+    // Literals and identifiers emit no code. Anything else may need A, so the left result is kept in memory meanwhile.
+    const EExpressionType rightExprType = binOpExpr->mRightOperand->GetExpressionType();
+    if (rightExprType != EExpressionType::Literal && rightExprType != EExpressionType::Identifier)
+        ConvertToAddress(leftExprAddr);
     EmitOperand rightExprAddr = EmitExpression(binOpExpr->mRightOperand);
 
-    if (binOpExpr->mValueType == "uint8_t")
+    if (binOpExpr->mValueType == mUInt8TypeID)
     {
-        if (binOpExpr->mOperator == "+" || binOpExpr->mOperator == "-")
+        if (binOpExpr->mOperator == EOperator::Plus || binOpExpr->mOperator == EOperator::Minus)
         {
+            if (rightExprAddr.mType == EOperandType::Register)
+            {
+                if (binOpExpr->mOperator == EOperator::Plus)
+                    std::swap(leftExprAddr, rightExprAddr);
+                else
+                    ConvertToAddress(rightExprAddr);
+            }
+
             EmitLoad(EProcReg::A, leftExprAddr);
-            if(binOpExpr->mOperator == "+")
+            if(binOpExpr->mOperator == EOperator::Plus)
                 EmitAcumulatorArithmetic(EAccumulatorArithmeticOp::ADC, rightExprAddr);
             else
                 EmitAcumulatorArithmetic(EAccumulatorArithmeticOp::SBC, rightExprAddr);
-            EmitStore(EProcReg::A, retAddr);
         }
-        else if (binOpExpr->mOperator == "==" || binOpExpr->mOperator == "!=")
+        else if (binOpExpr->mOperator == EOperator::Equal || binOpExpr->mOperator == EOperator::NotEqual)
         {
             EmitCompare(EProcReg::A, leftExprAddr, rightExprAddr);
             // Branch
-            uint16_t branchAddr = mEmitter->GetCurrentLocation();
-            if (binOpExpr->mOperator == "==")
-                EmitBranch(EBranchType::BEQ, 0); // dummy address (0) is relocated below
-            else if(binOpExpr->mOperator == "!=")
-                EmitBranch(EBranchType::BNE, 0); // dummy address (0) is relocated below
+            const LabelID trueLabel = mInstructions.NewLabel();
+            const LabelID endLabel = mInstructions.NewLabel();
+            if (binOpExpr->mOperator == EOperator::Equal)
+                EmitBranch(EBranchType::BEQ, trueLabel);
+            else if(binOpExpr->mOperator == EOperator::NotEqual)
+                EmitBranch(EBranchType::BNE, trueLabel);
             // TODO: ">"  "<" (BMI)  ">=" (BPL)  "<="
 
             // False case
             EmitLoad(EProcReg::A, EmitOperand(EOperandType::Value, 0, nullptr));
-            uint16_t jmpAddr = mEmitter->GetCurrentLocation();
-            EmitJump(EJumpType::JMP, EmitOperand(EOperandType::CodeAddress, 0, nullptr)); // dummy address (0) is relocated below
+            EmitJump(EJumpType::JMP, endLabel);
             // True case
-            uint16_t branchDest = mEmitter->GetCurrentLocation();
+            EmitLabel(trueLabel);
             EmitLoad(EProcReg::A, EmitOperand(EOperandType::Value, 1, nullptr));
-            uint16_t jmpDest = mEmitter->GetCurrentLocation();
-
-            // Relocate branch/jump destination addresses
-            // TODO: Use EmitBranchAt(...) and EmitJumpAt(...)
-            const uint16_t branchNextLoc = branchAddr + 2; // instruction after branch
-            const uint8_t displacement = (branchDest >= branchNextLoc) ? (branchDest - branchNextLoc) : (branchNextLoc - branchDest) | 0b10000000;
-            mEmitter->EmitDataAtPos(branchAddr + 1, reinterpret_cast<const char*>(&displacement), sizeof(displacement));
-            mEmitter->EmitDataAtPos(jmpAddr + 1, reinterpret_cast<const char*>(&jmpDest), sizeof(jmpDest));
-
-            // Write result
-            EmitStore(EProcReg::A, EmitOperand(EOperandType::DataAddress, retAddr.mAddress, nullptr));
+            EmitLabel(endLabel);
+            mRegisterState.OnModified(EProcReg::A); // both paths end with a load, so N and Z reflect A
         }
-		else if (binOpExpr->mOperator == "=")
+		else if (binOpExpr->mOperator == EOperator::Assign)
 		{
 			EmitStore(rightExprAddr, leftExprAddr);
+			retAddr = leftExprAddr;
 		}
     }
     else
@@ -547,93 +872,86 @@ void CodeGenerator::EmitControlStatement(ControlStatement* node)
 
 void CodeGenerator::EmitIfControlStatement(ControlStatement* node)
 {
-	uint16_t codeAddrStart = mEmitter->GetCurrentLocation();
-
 	// Emit condition expression
+	const size_t usedTempsMark = mUsedTemps.size();
 	EmitOperand exprAddr = EmitExpression(node->mExpression);
 
-	EmitLoad(EProcReg::A, exprAddr);
-
-	uint16_t condBranchLoc = mEmitter->GetCurrentLocation();
+	EmitLoad(EProcReg::A, exprAddr, true); // BEQ tests the Z flag
+	ReleaseTemps(usedTempsMark); // the body may reuse the condition's temporaries
 
-	EmitBranch(EBranchType::BEQ, 0); // relocated below
+	const LabelID elseLabel = mInstructions.NewLabel();
+	EmitBranch(EBranchType::BEQ, elseLabel);
 
 	// Emit body content
 	EmitNode(node->mBody);
 
-	// Jump to end, after executing body
-	uint16_t jmpLoc = mEmitter->GetCurrentLocation();
-	EmitJump(EJumpType::JMP, EmitOperand(EOperandType::CodeAddress, 0, nullptr)); // relocated below
-
-	uint16_t branchDest = mEmitter->GetCurrentLocation();
+	// Without an else, the body just falls through to the end
+	if (node->mConnectedStatement == nullptr)
+	{
+		EmitLabel(elseLabel);
+		return;
+	}
 
-	// TODO: Use JMP if displacement is exceeded
-	if (std::abs(branchDest - condBranchLoc) > 127)
-		printf("ERROR: Control statement body too large. Max displacement exceeded.\n");
+	// Jump to end, after executing body
+	const LabelID endLabel = mInstructions.NewLabel();
+	EmitJump(EJumpType::JMP, endLabel);
 
-	// Relocate branch destination address
-	const uint16_t branchNextLoc = condBranchLoc + 2;
-	const uint8_t branchDisplacement = static_cast<uint8_t>(branchDest - branchNextLoc);
-	mEmitter->EmitDataAtPos(condBranchLoc + 1, reinterpret_cast<const char*>(&branchDisplacement), sizeof(uint8_t));
+	EmitLabel(elseLabel);
 
 	// else { ... }
-	if (node->mConnectedStatement != nullptr)
-	{
-		EmitNode(node->mConnectedStatement);
-	}
+	EmitNode(node->mConnectedStatement);
 
 	// end (jump here after executing main body)
-	uint16_t endPos = mEmitter->GetCurrentLocation();
-	mEmitter->EmitDataAtPos(jmpLoc + 1, reinterpret_cast<const char*>(&endPos), sizeof(uint16_t));
+	EmitLabel(endLabel);
 }
 
 void CodeGenerator::EmitWhileControlStatement(ControlStatement* node)
 {
-	uint16_t codeAddrStart = mEmitter->GetCurrentLocation();
+	const LabelID startLabel = mInstructions.NewLabel();
+	EmitLabel(startLabel);
+
+	const uint32_t outerAccessWeight = mAccessWeight;
+	mAccessWeight = GetLoopWeight(mAccessWeight);
 
 	// Emit condition expression
+	const size_t usedTempsMark = mUsedTemps.size();
 	EmitOperand exprAddr = EmitExpression(node->mExpression);
 
-	EmitLoad(EProcReg::A, exprAddr);
+	EmitLoad(EProcReg::A, exprAddr, true); // BEQ tests the Z flag
+	ReleaseTemps(usedTempsMark); // the body may reuse the condition's temporaries
 
-	uint16_t condBranchLoc = mEmitter->GetCurrentLocation();
-
-	EmitBranch(EBranchType::BEQ, 0); // relocated below
+	const LabelID endLabel = mInstructions.NewLabel();
+	EmitBranch(EBranchType::BEQ, endLabel);
 
 	// Emit body content
 	EmitNode(node->mBody);
 
 	// jump back to start (after body)
-	EmitJump(EJumpType::JMP, EmitOperand(EOperandType::CodeAddress, codeAddrStart, nullptr));
-
-	uint16_t branchDest = mEmitter->GetCurrentLocation();
+	EmitJump(EJumpType::JMP, startLabel);
 
-	// TODO: Use JMP if displacement is exceeded
-	if (std::abs(branchDest - condBranchLoc) > 127)
-		printf("ERROR: Control statement body too large. Max displacement exceeded.\n");
+	EmitLabel(endLabel);
 
-	// Relocate branch destination address
-	const uint16_t branchNextLoc = condBranchLoc + 2;
-	const uint8_t branchDisplacement = static_cast<uint8_t>(branchDest - branchNextLoc);
-	mEmitter->EmitDataAtPos(condBranchLoc + 1, reinterpret_cast<const char*>(&branchDisplacement), sizeof(uint8_t));
+	mAccessWeight = outerAccessWeight;
 }
 
 void CodeGenerator::EmitStatement(Statement* node)
 {
+    // Temporaries requested by this statement die with it
+    const size_t usedTempsMark = mUsedTemps.size();
+
     EStatementType type = node->GetStatementType();
     switch (type)
     {
     case EStatementType::VariableDefinition:
     {
         VarDefStatement* varDefStm = static_cast<VarDefStatement*>(node);
-        Symbol* stmsym = mCompilationUnit->mSymbolTable[varDefStm->mName];
-        Symbol* typesym = mCompilationUnit->mSymbolTable[varDefStm->mType];
+        Symbol* stmsym = varDefStm->mSymbol;
+        Symbol* typesym = stmsym->mTypeSymbol;
         
         if (stmsym->mAddrType == ESymAddrType::None) // not yet defined
         {
-            stmsym->mAddrType = ESymAddrType::Absolute;
-            stmsym->mAddress = mDataAllocator->RequestVarAddr(typesym->mSize);
             stmsym->mSize = typesym->mSize; // ??
+            AllocateSymbolData(stmsym);
         }
 
         if (varDefStm->mExpression != nullptr)
@@ -679,10 +997,9 @@ void CodeGenerator::EmitStatement(Statement* node)
 
         if (retStm->mExpression != nullptr)
         {
+            // Return values are passed in A
             EmitOperand retExprAddr = EmitExpression(retStm->mExpression);
-
-            Symbol* funcSym = mCompilationUnit->mSymbolTable[retStm->mFunction];
-            mFuncRetAddrs[funcSym->mUniqueName] = retExprAddr;
+            EmitLoad(EProcReg::A, retExprAddr);
         }
 
         Emit("RTS");
@@ -698,6 +1015,8 @@ void CodeGenerator::EmitStatement(Statement* node)
     default:
         assert(0); // TODO
     }
+
+    ReleaseTemps(usedTempsMark);
 }
 
 void CodeGenerator::EmitFunction(FunctionDefinition* node)
@@ -706,20 +1025,22 @@ void CodeGenerator::EmitFunction(FunctionDefinition* node)
     if (node->mContent == nullptr)
         return;
 
-    Symbol* funcSym = mCompilationUnit->mSymbolTable[node->mName];
+    Symbol* funcSym = node->mSymbol;
     funcSym->mAddrType = ESymAddrType::Absolute;
+    FlushInstructions(); // code outside of functions
     funcSym->mAddress = mEmitter->GetCurrentLocation();
+    OnLabel();
+    ResetTemps();
 
     // Parameters
     VarDefStatement* currParam = static_cast<VarDefStatement*>(node->mParams);
     while (currParam != nullptr)
     {
         // Update symbol
-        Symbol* paramSym = mCompilationUnit->mSymbolTable[currParam->mName];
+        Symbol* paramSym = currParam->mSymbol;
         SetIdentifierSymSize(paramSym);
         // Set address
-        paramSym->mAddrType = ESymAddrType::Absolute;
-        paramSym->mAddress = mDataAllocator->RequestVarAddr(paramSym->mSize);
+        AllocateSymbolData(paramSym);
 
         currParam = static_cast<VarDefStatement*>(currParam->mNext);
     }
@@ -733,10 +1054,12 @@ void CodeGenerator::EmitFunction(FunctionDefinition* node)
     }
 
     // void return
-    if (node->mType == "void")
+    if (node->mType == mVoidTypeID)
         Emit("RTS");
 
+    FlushInstructions();
     funcSym->mSize = mEmitter->GetCurrentLocation() - funcSym->mAddress;
+    ResetTemps();
 }
 
 void CodeGenerator::EmitStruct(StructDefinition* node)
@@ -745,9 +1068,9 @@ void CodeGenerator::EmitStruct(StructDefinition* node)
     if (node->mContent == nullptr)
         return;
 
-    Symbol* structSym = mCompilationUnit->mSymbolTable[node->mName];
+    Symbol* structSym = node->mSymbol;
     structSym->mAddrType = ESymAddrType::Absolute;
-    structSym->mAddress = mEmitter->GetCurrentLocation();
+    structSym->mAddress = GetCodeLocation();
 
     Node* currContent = node->mContent;
     while (currContent != nullptr)
@@ -756,29 +1079,67 @@ void CodeGenerator::EmitStruct(StructDefinition* node)
         currContent = currContent->mNext;
     }
 
-    structSym->mAddress = mEmitter->GetCurrentLocation() - structSym->mAddress;
+    structSym->mAddress = GetCodeLocation() - structSym->mAddress;
 }
 
 void CodeGenerator::EmitInlineAssembly(InlineAssemblyStatement* node)
 {
-    std::transform(node->mOpcodeName.begin(), node->mOpcodeName.end(), node->mOpcodeName.begin(), ::toupper);
-
-    if (node->mOpcodeName == "")
-        mEmitter->Emit(node->mOp1.c_str());
+    std::string opcodeName(node->mOpcodeName);
+    const std::string op1(node->mOp1);
+    std::string op2(node->mOp2);
+    std::transform(opcodeName.begin(), opcodeName.end(), opcodeName.begin(), ::toupper);
+
+    const size_t firstInstruction = mInstructions.GetInstructions().size();
+    if (opcodeName == "")
+        Emit(op1.c_str());
     else
     {
         EAddressingMode addrMode = static_cast<EAddressingMode>(-1);
 
-        auto opSymIter = mCompilationUnit->mSymbolTable.find(node->mOp1);
+        const Symbol* opSym = node->mOp1Symbol;
+
+        const bool isSym = opSym != nullptr;
+        const bool isVal = op1[0] == '#';
+        const bool isHex = op1[isVal ? 1 : 0] == '$';
+		const bool isAccum = op1 == "A";
+        const std::string opValStr = op1.substr((isVal ? 1 : 0) + (isHex ? 1 : 0));
+        std::transform(op2.begin(), op2.end(), op2.begin(), ::tolower);
+
+        // Get operand value
+        unsigned int opVal = 0;
+        if (isSym)
+        {
+            opVal = static_cast<unsigned int>(opSym->mAddress);
+        }
+        else if (isHex)
+        {
+            std::stringstream ss;
+            ss << std::hex << opValStr;
+            ss >> opVal;
+        }
+        else if (isVal)
+            opVal = std::stoi(opValStr);
 
-        const bool isSym = opSymIter != mCompilationUnit->mSymbolTable.end();
-        const bool isVal = node->mOp1[0] == '#';
-        const bool isHex = node->mOp1[isVal ? 1 : 0] == '$';
-		const bool isAccum = node->mOp1 == "A";
-        const std::string opValStr = node->mOp1.substr((isVal ? 1 : 0) + (isHex ? 1 : 0));
+        // Memory operands use the zero page form when the address fits and the instruction has one
+        auto getMemoryAddrMode = [&](bool fitsZeroPage)
+        {
+            EAddressingMode zeroPageMode = EAddressingMode::ZeroPage;
+            EAddressingMode absoluteMode = EAddressingMode::Absolute;
+            if (op2 == "x")
+            {
+                zeroPageMode = EAddressingMode::ZeroPageX;
+                absoluteMode = EAddressingMode::AbsoluteX;
+            }
+            else if (op2 == "y")
+            {
+                zeroPageMode = EAddressingMode::ZeroPageY;
+                absoluteMode = EAddressingMode::AbsoluteY;
+            }
+            return fitsZeroPage && mEmitter->HasAddressingMode(opcodeName.c_str(), zeroPageMode) ? zeroPageMode : absoluteMode;
+        };
 
         // Get addressing mode
-		if (node->mOp1 == "")
+		if (op1 == "")
 		{
 			addrMode = EAddressingMode::Implied;
 		}
@@ -788,7 +1149,8 @@ void CodeGenerator::EmitInlineAssembly(InlineAssemblyStatement* node)
         }
         else if (isSym)
         {
-            addrMode = EAddressingMode::Absolute;
+            // Symbols this unit didn't place in zero page are shrunk by the linker if they land there
+            addrMode = getMemoryAddrMode(IsZeroPageSymbol(opSym));
         }
 		else if (isAccum)
 		{
@@ -797,51 +1159,23 @@ void CodeGenerator::EmitInlineAssembly(InlineAssemblyStatement* node)
         else
         {
             assert(isHex);
-            const size_t opSize = opValStr.size() / 2;
-            assert(0 < opSize < 3);
-
-            const bool isAbsolute = opSize == 2;
-
-            if (node->mOp2 == "")
-            {
-                if (isAbsolute)
-                    addrMode = EAddressingMode::Absolute;
-                else
-                    addrMode = EAddressingMode::ZeroPage;
-            }
-            else
-            {
-                std::transform(node->mOp2.begin(), node->mOp2.end(), node->mOp2.begin(), ::tolower);
-
-                if (isAbsolute && node->mOp2 == "x")
-                    addrMode = EAddressingMode::AbsoluteX;
-                else if (isAbsolute && node->mOp2 == "y")
-                    addrMode = EAddressingMode::AbsoluteY;
-                else if (node->mOp2 == "x")
-                    addrMode = EAddressingMode::ZeroPageX;
-                else if (node->mOp2 == "y")
-                    addrMode = EAddressingMode::ZeroPageY;
-            }
+            addrMode = getMemoryAddrMode(opVal <= 0xff);
         }
         assert(addrMode != -1);
         
-		// Get operand value
-		unsigned int opVal = 0;
-		if (isSym)
-		{
-			opVal = static_cast<unsigned int>(opSymIter->second->mAddress);
-		}
-		else if (isHex)
-		{
-			std::stringstream ss;
-			ss << std::hex << opValStr;
-			ss >> opVal;
-		}
-		else if(addrMode != EAddressingMode::Implied && addrMode != EAddressingMode::Accumulator)
-			opVal = std::stoi(opValStr);
-		
-		mEmitter->Emit(node->mOpcodeName.c_str(), addrMode, static_cast<uint16_t>(opVal));
+		const ESymbolType symType = isSym ? opSym->mSymbolType : ESymbolType::None;
+		if (symType == ESymbolType::Variable || symType == ESymbolType::FuncParam)
+			EmitDataAddress(opcodeName.c_str(), addrMode, static_cast<uint16_t>(opVal));
+		else
+			Emit(opcodeName.c_str(), addrMode, static_cast<uint16_t>(opVal));
     }
+
+    std::vector<Instruction>& instructions = mInstructions.GetInstructions();
+    for (size_t index = firstInstruction; index < instructions.size(); ++index)
+        instructions[index].mInlineAssembly = true;
+
+    // Hand-written code may change any register or memory
+    mRegisterState.Clear();
 }
 
 void CodeGenerator::EmitBlock(Block* node)
@@ -880,10 +1214,15 @@ void CodeGenerator::EmitNode(Node* node)
 
 void CodeGenerator::Generate()
 {
+    for (Node* currNode = mCompilationUnit->mRootNode; currNode != nullptr; currNode = currNode->mNext)
+        CountAccesses(currNode, 1);
+    ChooseZeroPageSymbols();
+
     Node* currNode = mCompilationUnit->mRootNode;
     while (currNode != nullptr)
     {
         EmitNode(currNode);
         currNode = currNode->mNext;
     }
+    FlushInstructions();
 }
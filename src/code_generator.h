@@ -1,8 +1,12 @@
 #pragma once
 #include "compilation_unit.h"
 #include "emitter.h"
+#include "instruction_list.h"
+#include "peephole.h"
 #include <stdint.h>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 enum class EProcReg
 {
@@ -26,7 +30,7 @@ enum class EBranchType
 
 enum class EOperandType
 {
-    None, Value, DataAddress, CodeAddress
+    None, Value, DataAddress, CodeAddress, Register
 };
 
 class EmitOperand
@@ -50,14 +54,47 @@ public:
         mAddress = addr;
         mRelativeSymbol = sym;
     }
+
+    // Value held in a register. Only valid until the register is changed.
+    explicit EmitOperand(EProcReg reg)
+    {
+        mType = EOperandType::Register;
+        mRegister = reg;
+    }
+
+    // Same value or memory location?
+    bool operator==(const EmitOperand& other) const;
 };
 
-class DataAllocator
+/**
+* What the code generator knows about the contents of A, X and Y.
+* Each register has the set of operands known to equal it: immediate values and memory locations
+*  (ex: after LDA #1, STA $0000, STA $0001, A == #1 == $0000 == $0001).
+* Stores invalidate the location in every register. Calls and branch targets forget everything.
+*/
+class RegisterState
 {
 private:
-    uint16_t mNextVarAddr = 0x0000;
+    std::vector<EmitOperand> mValues[3]; // indexed by EProcReg
+    bool mFlagsValid[3] = {}; // do the N and Z flags reflect the register?
+
 public:
-    uint16_t RequestVarAddr(uint16_t bytes);
+    bool Contains(EProcReg reg, const EmitOperand& operand) const;
+    bool FlagsReflect(EProcReg reg) const { return mFlagsValid[static_cast<int>(reg)]; }
+
+    // The register was loaded with (or computed to) the operand
+    void OnLoad(EProcReg reg, const EmitOperand& operand);
+    // The register was stored to a memory location
+    void OnStore(EProcReg reg, const EmitOperand& location);
+    // The register was changed to an unknown value
+    void OnModified(EProcReg reg);
+    // The flags were changed (ex: CMP)
+    void OnFlagsModified();
+    // N and Z were set from the register (ex: AND #$FF)
+    void OnFlagsSet(EProcReg reg);
+    // The register was copied to another one (ex: TAX)
+    void OnTransfer(EProcReg src, EProcReg dst);
+    void Clear();
 };
 
 class CodeGenerator
@@ -65,14 +102,26 @@ class CodeGenerator
 private:
     CompilationUnit * mCompilationUnit;
     Emitter* mEmitter;
-    std::unordered_map<std::string, EmitOperand> mFuncRetAddrs; // TODO: remove this hack
-    DataAllocator* mDataAllocator;
-
-    std::unordered_map<EProcReg, EmitOperand> mRegisterContent;
-
-    void CacheRegisterContent(EProcReg reg, EmitOperand val);
-    bool RegisterContains(EProcReg reg, EmitOperand val);
-    void ClearRegisterContentCache(EProcReg reg);
+    InstructionList mInstructions; // code of the current function, encoded when it ends
+    PeepholeOptimiser mPeephole;
+    uint16_t mDataSize = 0; // bytes of RAM allocated by this unit
+    // Temporaries of the current function. A temporary only lives until the end of the statement that
+    //  requested it, so they are recycled per statement. Functions don't share them, since a call can
+    //  happen while the caller's temporaries are still alive.
+    std::vector<uint16_t> mUsedTemps;
+    std::vector<uint16_t> mFreeTemps;
+
+    // Zero page. Static accesses are counted per symbol before emitting, weighted by loop depth, and the
+    //  hottest data of the unit gets zero page up to the budget (the rest is left to the other units).
+    std::unordered_map<const Symbol*, uint32_t> mAccessWeights;
+    std::vector<const Symbol*> mAccessedSymbols; // in order of first access
+    std::unordered_set<const Symbol*> mZeroPageSymbols;
+    uint16_t mZeroPageBytesLeft;
+    uint32_t mAccessWeight = 1; // weight of the code being emitted
+    IdentifierID mUInt8TypeID;
+    IdentifierID mVoidTypeID;
+
+    RegisterState mRegisterState;
 
     const char* GetLoadOpcode(const EProcReg reg);
     const char* GetStoreOpcode(const EProcReg reg);
@@ -80,25 +129,51 @@ private:
     const char* GetAccArithOp(const EAccumulatorArithmeticOp op);
     const char* GetBranchOp(const EBranchType type);
 
-    void RegisterBuiltinSymbol(std::string name, uint16_t size);
     void SetIdentifierSymSize(Symbol* sym);
 
+    void AddAccess(const Symbol* sym, uint32_t weight);
+    void CountAccesses(Expression* expr, uint32_t weight);
+    void CountAccesses(Node* node, uint32_t weight);
+    void ChooseZeroPageSymbols();
+    bool IsZeroPageSymbol(const Symbol* sym) const;
+    DataSymbol* FindDataSymbol(uint16_t localAddr);
+
+    uint16_t AllocateData(uint16_t bytes, uint16_t alignment = 1, bool zeroPage = false, uint32_t weight = 0);
+    void AllocateSymbolData(Symbol* sym);
+    uint16_t AllocateTemp();
+    void ReleaseTemps(size_t usedTempsMark);
+    void ResetTemps();
     void ConvertToAddress(EmitOperand& operand);
+    uint16_t GetCodeLocation(); // including the instructions that haven't been encoded yet
+    void FlushInstructions();
     void Emit(const char* op);
+    void Emit(const char* op, const EAddressingMode addrMode, const uint16_t value);
     void EmitRelocatedAddress(const std::string& op, const EAddressingMode addrMode, const uint16_t addr);
+    void EmitDataAddress(const char* op, const EAddressingMode addrMode, const uint16_t addr);
+    // Memory operand of a load, store, compare or arithmetic instruction
+    void EmitDataOperand(const char* op, const EmitOperand& operand);
     void EmitRelocatedSymbol(const std::string& op, const EAddressingMode addrMode, const Symbol* sym, const uint16_t offset = 0);
-    void EmitLoad(const EProcReg reg, const EmitOperand operand);
+    // Skipped when the register already holds the operand (and, if needFlags, N and Z reflect it)
+    void EmitLoad(const EProcReg reg, const EmitOperand operand, bool needFlags = false);
+    // Code reachable from elsewhere (branch or jump target) starts here
+    void OnLabel();
+    void EmitLabel(LabelID label);
+    void EmitTransfer(const EProcReg src, const EProcReg dst, bool needFlags = false);
     void EmitStore(const EProcReg reg, const EmitOperand operand);
     void EmitStore(const EmitOperand src, const EmitOperand dst);
-    void EmitBranch(EBranchType type, int8_t offset);
-    void EmitBranchAt(EBranchType type, uint8_t offset, uint16_t branchCodeAddr);
+    void EmitBranch(EBranchType type, LabelID label);
     void EmitCompare(EProcReg reg, EmitOperand operand1, EmitOperand operand2);
     void EmitCompare(EProcReg reg, EmitOperand operand);
     void EmitAcumulatorArithmetic(EAccumulatorArithmeticOp op, EmitOperand operand);
     void EmitJump(EJumpType type, EmitOperand operand);
+    void EmitJump(EJumpType type, LabelID label);
 
 public:
-    CodeGenerator(CompilationUnit* compilationUnit, Emitter* emitter, DataAllocator* dataAllocator);
+    // Zero page reserved at compile time can't be given back, so by default the units reserve none: the linker
+    //  places the hottest data of all units in zero page, and shrinks the operands that land there.
+    static const uint16_t DefaultZeroPageBudget = 0;
+
+    CodeGenerator(CompilationUnit* compilationUnit, Emitter* emitter, uint16_t zeroPageBudget = DefaultZeroPageBudget);
 
     EmitOperand EmitLiteralExpression(LiteralExpression* litExpr);
     EmitOperand EmitIdentifierExpression(IdentifierExpression* identExpr);
@@ -115,4 +190,6 @@ public:
     void EmitBlock(Block* node);
     void EmitNode(Node* node);
     void Generate();
+
+    const PeepholeOptimiser& GetPeephole() const { return mPeephole; }
 };
@@ -1 +1,22 @@
 #include "compilation_unit.h"
+#include <algorithm>
+
+const SourceFile* CompilationUnit::OpenSourceFile(const std::string& path)
+{
+    std::shared_ptr<SourceFile> sourceFile = std::make_shared<SourceFile>();
+    if (!sourceFile->Open(path))
+        return nullptr;
+    mSourceFiles.push_back(std::move(sourceFile));
+    return mSourceFiles.back().get();
+}
+
+void CompilationUnit::RetainSourceFile(std::shared_ptr<SourceFile> sourceFile)
+{
+    if (std::find(mSourceFiles.begin(), mSourceFiles.end(), sourceFile) == mSourceFiles.end())
+        mSourceFiles.push_back(sourceFile);
+}
+
+std::string_view CompilationUnit::AddGeneratedText(std::string_view text)
+{
+    return mArena.CopyString(text);
+}
@@ -3,8 +3,12 @@
 #include <unordered_map>
 #include <string>
 #include <vector>
+#include <memory>
 #include "node.h"
+#include "identifier_table.h"
+#include "source_file.h"
 #include "relocation.h"
+#include "arena.h"
 
 enum class ESymbolType
 {
@@ -40,8 +44,8 @@ class Symbol; // fwd. decl.
 class SymbolList
 {
 public:
-    Symbol * mHead = nullptr;
-    Symbol* mTail = nullptr;
+    Symbol* mHead = nullptr; // first declared
+    Symbol* mTail = nullptr; // last declared
     Symbol* mOwningSymbol = nullptr;
     SymbolList* mParent = nullptr;
     std::string mName = "";
@@ -52,12 +56,16 @@ class Symbol
 public:
     ESymbolType mSymbolType;
     std::string mName;
+    IdentifierID mNameID = InvalidIdentifierID;
     std::string mUniqueName;
-    // next symbol (in same scope)
+    // next symbol (in same scope, in declaration order)
     Symbol* mNext = nullptr;
+    // symbol with the same name that this one hides, while analysing this one's scope
+    Symbol* mShadowed = nullptr;
     SymbolList* mChildren = nullptr;
     // type name (of variable/function)
     std::string mTypeName;
+    Symbol* mTypeSymbol = nullptr;
     // address type (relative or absolute)
     ESymAddrType mAddrType = ESymAddrType::None; // None = not set
     // type name (of variable/function)
@@ -68,9 +76,22 @@ public:
 struct CompilationUnit
 {
 public:
+    IdentifierTable* mIdentifierTable = nullptr;
+    // AST nodes and their strings. Freed all at once with the unit.
+    Arena mArena;
+    // Source files (main file and included files). Tokens refer to these, so they stay open as long as the unit.
+    std::vector<std::shared_ptr<SourceFile>> mSourceFiles;
+
     std::unordered_map<std::string, Symbol*> mSymbolTable;
     Node* mRootNode;
 
     std::vector<char> mObjectCode;
     RelocationText mRelocationText;
+    // Set if an error was logged while compiling the unit, or while tokenising a header it includes
+    bool mHasErrors = false;
+
+    const SourceFile* OpenSourceFile(const std::string& path);
+    void RetainSourceFile(std::shared_ptr<SourceFile> sourceFile);
+    // Text created by the preprocessor (stringified and pasted tokens)
+    std::string_view AddGeneratedText(std::string_view text);
 };
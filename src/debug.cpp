@@ -1,7 +1,8 @@
 #include "debug.h"
 
-DEBUG_MODE Debug::outputMode = DEBUG_MODE_NONE;
 DEBUG_MODE Debug::terminalLogMode = DEBUG_MODE_ALL;
 DEBUG_MODE Debug::fileLogMode = DEBUG_MODE_ERROR;
 
 bool Debug::firstTime = true;
+thread_local size_t Debug::errorCount = 0;
+std::mutex Debug::outputMutex;
@@ -5,6 +5,7 @@
 #include <sstream>
 #include <string>
 #include <fstream>
+#include <mutex>
 
 #define DEBUG_MODE_NONE				0x0000
 #define DEBUG_MODE_INFO				0x0001
@@ -22,6 +23,8 @@ public:
     Debug(DEBUG_MODE mode, const char* arg_file, int arg_line)
     {
         outputMode = mode;
+        if (outputMode & DEBUG_MODE_ERROR)
+            errorCount++;
 
         if (!(outputMode & (fileLogMode | terminalLogMode)))
             return;
@@ -72,6 +75,9 @@ public:
     {
         _buffer << _buffersuffix.str();
         _buffer << std::endl;
+
+        // Units may be compiled on several threads
+        std::lock_guard<std::mutex> lock(outputMutex);
         std::cout << _buffer.str();
 
 
@@ -98,13 +104,21 @@ public:
         fileLogMode = mode;
     }
 
+    // Number of errors logged so far by the calling thread (a unit is compiled on one thread)
+    static size_t GetErrorCount()
+    {
+        return errorCount;
+    }
+
 private:
     std::ostringstream _buffer;
     std::ostringstream _buffersuffix;
     static DEBUG_MODE terminalLogMode;
     static DEBUG_MODE fileLogMode;
-    static DEBUG_MODE outputMode;
+    DEBUG_MODE outputMode;
     static bool firstTime;
+    static thread_local size_t errorCount;
+    static std::mutex outputMutex;
 };
 
 
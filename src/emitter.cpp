@@ -43,6 +43,12 @@ uint16_t Emitter::Emit(const char* op)
     return Emit(op, EAddressingMode::Implied, 0); // TODO: we can simplify this
 }
 
+bool Emitter::HasAddressingMode(const char* op, EAddressingMode addrMode) const
+{
+    Opcode opcode;
+    return mOpcodeTranslator->GetOpcode(op, addrMode, opcode);
+}
+
 uint16_t Emitter::Emit(const char* op, EAddressingMode addrMode, uint16_t val)
 {
     Opcode opcode;
@@ -26,6 +26,7 @@ public:
     void EmitDataAtPos(size_t pos, const char* data, size_t size);
     uint16_t Emit(const char* op);
     uint16_t Emit(const char* op, EAddressingMode addrMode, uint16_t val);
+    bool HasAddressingMode(const char* op, EAddressingMode addrMode) const;
 
     uint16_t GetCurrentLocation() { return mCurrentLocation; }
 
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+const uint64_t FNV1aOffsetBasis = 0xcbf29ce484222325ULL;
+
+/**
+* 64-bit FNV-1a hash. Pass the previous hash as seed to hash several buffers.
+*/
+inline uint64_t HashFNV1a(const void* data, size_t size, uint64_t seed = FNV1aOffsetBasis)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
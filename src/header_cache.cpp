@@ -0,0 +1,109 @@
+#include "header_cache.h"
+#include "debug.h"
+#include <filesystem>
+
+HeaderCache::HeaderCache(IdentifierTable* identifierTable)
+{
+    mIdentifierTable = identifierTable;
+}
+
+std::string HeaderCache::GetCanonicalPath(const std::string& path)
+{
+    std::error_code errorCode;
+    std::filesystem::path absolutePath = std::filesystem::absolute(path, errorCode);
+    if (errorCode)
+        return path;
+    return absolutePath.lexically_normal().string();
+}
+
+IdentifierID HeaderCache::DetectIncludeGuard(const std::vector<Token>& tokens)
+{
+    // Skip line breaks
+    size_t tokenIndex = 0;
+    auto nextToken = [&]() -> const Token*
+    {
+        while (tokenIndex < tokens.size() && tokens[tokenIndex].mTokenType == ETokenType::NewLine)
+            tokenIndex++;
+        return tokenIndex < tokens.size() ? &tokens[tokenIndex++] : nullptr;
+    };
+
+    // #ifndef X
+    // #define X
+    const Token* ifndefToken = nextToken();
+    const Token* guardToken = nextToken();
+    if (ifndefToken == nullptr || guardToken == nullptr || ifndefToken->mTokenString != "#ifndef" || guardToken->mTokenType != ETokenType::Identifier)
+        return InvalidIdentifierID;
+    const Token* defineToken = nextToken();
+    const Token* defNameToken = nextToken();
+    if (defineToken == nullptr || defNameToken == nullptr || defineToken->mTokenString != "#define" || defNameToken->mIdentifierID != guardToken->mIdentifierID)
+        return InvalidIdentifierID;
+
+    // The #endif of the #ifndef must be the last token of the file, with no #else/#elif branch of its own
+    int depth = 1;
+    while (const Token* token = nextToken())
+    {
+        if (token->mTokenType != ETokenType::PreprocessorDirective)
+            continue;
+        if (token->mTokenString == "#ifdef" || token->mTokenString == "#ifndef" || token->mTokenString == "#if")
+            depth++;
+        else if ((token->mTokenString == "#else" || token->mTokenString == "#elif") && depth == 1)
+            return InvalidIdentifierID;
+        else if (token->mTokenString == "#endif" && --depth == 0)
+            return nextToken() == nullptr ? guardToken->mIdentifierID : InvalidIdentifierID;
+    }
+    return InvalidIdentifierID;
+}
+
+std::shared_ptr<const CachedHeader> HeaderCache::GetHeader(const std::string& canonicalPath)
+{
+    HeaderEntry* entry;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        std::unique_ptr<HeaderEntry>& entryPtr = mHeaders[canonicalPath];
+        if (entryPtr == nullptr)
+            entryPtr = std::make_unique<HeaderEntry>();
+        entry = entryPtr.get();
+    }
+
+    std::call_once(entry->mLoaded, [&]() { entry->mHeader = LoadHeader(canonicalPath); });
+    return entry->mHeader;
+}
+
+std::shared_ptr<const CachedHeader> HeaderCache::LoadHeader(const std::string& canonicalPath)
+{
+    std::shared_ptr<SourceFile> sourceFile = std::make_shared<SourceFile>();
+    if (!sourceFile->Open(canonicalPath))
+        return nullptr;
+
+    std::shared_ptr<CachedHeader> header = std::make_shared<CachedHeader>();
+    header->mPath = canonicalPath;
+    header->mSourceFile = sourceFile;
+
+    const size_t errorCount = Debug::GetErrorCount();
+    Tokeniser tokeniser(sourceFile->GetData(), sourceFile->GetSize(), mIdentifierTable);
+    while (true)
+    {
+        Token token = tokeniser.ParseToken();
+        if (token.mTokenType == ETokenType::EndOfFile)
+            break;
+        header->mTokens.push_back(token);
+    }
+    header->mGuardMacro = DetectIncludeGuard(header->mTokens);
+    header->mHasErrors = Debug::GetErrorCount() != errorCount;
+    return header;
+}
+
+CachedHeaderTokenSource::CachedHeaderTokenSource(std::shared_ptr<const CachedHeader> header)
+    : mHeader(header)
+{
+}
+
+Token CachedHeaderTokenSource::NextToken()
+{
+    if (mTokenIndex < mHeader->mTokens.size())
+        return mHeader->mTokens[mTokenIndex++];
+
+    Token eofToken;
+    eofToken.mTokenType = ETokenType::EndOfFile;
+    return eofToken;
+}
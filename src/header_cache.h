@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <mutex>
+#include "tokeniser.h"
+#include "source_file.h"
+
+/**
+* A tokenised header file.
+*/
+struct CachedHeader
+{
+    std::string mPath;
+    std::shared_ptr<SourceFile> mSourceFile; // the tokens refer to this
+    std::vector<Token> mTokens;
+    // Include guard macro (#ifndef X / #define X ... #endif around the whole file), if any
+    IdentifierID mGuardMacro = InvalidIdentifierID;
+    // Set if tokenising the header logged errors. They are only logged once, so every unit that includes it is marked.
+    bool mHasErrors = false;
+};
+
+/**
+* Cache of tokenised header files, shared by all compilation units.
+* A header that is included by many units is only read and tokenised once.
+* Units compiled on other threads wait for a header that is being tokenised, instead of tokenising it again.
+*/
+class HeaderCache
+{
+private:
+    struct HeaderEntry
+    {
+        std::once_flag mLoaded;
+        std::shared_ptr<const CachedHeader> mHeader;
+    };
+
+    IdentifierTable* mIdentifierTable;
+    std::unordered_map<std::string, std::unique_ptr<HeaderEntry>> mHeaders;
+    std::mutex mMutex; // guards mHeaders (not the entries)
+
+    static IdentifierID DetectIncludeGuard(const std::vector<Token>& tokens);
+    std::shared_ptr<const CachedHeader> LoadHeader(const std::string& canonicalPath);
+
+public:
+    HeaderCache(IdentifierTable* identifierTable);
+
+    static std::string GetCanonicalPath(const std::string& path);
+
+    // Returns nullptr if the file can't be opened.
+    std::shared_ptr<const CachedHeader> GetHeader(const std::string& canonicalPath);
+};
+
+/**
+* Reads the tokens of a cached header.
+*/
+class CachedHeaderTokenSource : public TokenSource
+{
+private:
+    std::shared_ptr<const CachedHeader> mHeader;
+    size_t mTokenIndex = 0;
+
+public:
+    CachedHeaderTokenSource(std::shared_ptr<const CachedHeader> header);
+
+    virtual Token NextToken() override;
+};
@@ -0,0 +1,40 @@
+#include "identifier_table.h"
+
+IdentifierTable::IdentifierTable()
+{
+    Intern(""); // InvalidIdentifierID
+}
+
+IdentifierID IdentifierTable::Intern(std::string_view name)
+{
+    // Most names are already interned, so look them up under the shared lock first
+    {
+        std::shared_lock<std::shared_mutex> lock(mMutex);
+        auto idIter = mIDs.find(name);
+        if (idIter != mIDs.end())
+            return idIter->second;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mMutex);
+    auto idIter = mIDs.find(name);
+    if (idIter != mIDs.end())
+        return idIter->second;
+
+    const IdentifierID id = static_cast<IdentifierID>(mNames.size());
+    mNames.emplace_back(name);
+    mIDs.emplace(mNames.back(), id);
+    return id;
+}
+
+IdentifierID IdentifierTable::Find(std::string_view name) const
+{
+    std::shared_lock<std::shared_mutex> lock(mMutex);
+    auto idIter = mIDs.find(name);
+    return idIter != mIDs.end() ? idIter->second : InvalidIdentifierID;
+}
+
+std::string_view IdentifierTable::GetName(IdentifierID id) const
+{
+    std::shared_lock<std::shared_mutex> lock(mMutex);
+    return mNames[id];
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <deque>
+#include <unordered_map>
+#include <mutex>
+#include <shared_mutex>
+#include <stdint.h>
+
+typedef uint32_t IdentifierID;
+
+// ID of the empty identifier. Tokens that are not identifiers have this ID.
+const IdentifierID InvalidIdentifierID = 0;
+
+/**
+* Interns identifier names, and maps them to integer IDs.
+* The same name always gets the same ID, so identifiers can be compared and hashed as integers.
+* Shared by all compilation units, so it is safe to use from several threads.
+*/
+class IdentifierTable
+{
+private:
+    std::deque<std::string> mNames; // indexed by ID (deque: views into the strings stay valid)
+    std::unordered_map<std::string_view, IdentifierID> mIDs;
+    mutable std::shared_mutex mMutex;
+
+public:
+    IdentifierTable();
+
+    IdentifierID Intern(std::string_view name);
+    IdentifierID Find(std::string_view name) const;
+    std::string_view GetName(IdentifierID id) const;
+};
@@ -0,0 +1,135 @@
+#include "instruction_list.h"
+#include "emitter.h"
+#include "relocation.h"
+#include "compilation_unit.h"
+#include "debug.h"
+
+bool Instruction::IsBranch() const
+{
+    Opcode opcode;
+    opcode.mName = mOpcodeName;
+    opcode.mAddressingMode = mAddressingMode;
+    return !IsLabel() && OpcodeTranslator::IsBranch(opcode);
+}
+
+void InstructionList::BindLabel(LabelID label)
+{
+    Instruction instruction;
+    instruction.mLabel = label;
+    mInstructions.push_back(instruction);
+}
+
+void InstructionList::Add(const char* op, EAddressingMode addrMode, uint16_t value, EInstructionRelocation relocation)
+{
+    Instruction instruction;
+    instruction.mOpcodeName = op;
+    instruction.mAddressingMode = addrMode;
+    instruction.mValue = value;
+    instruction.mRelocation = relocation;
+    mInstructions.push_back(instruction);
+}
+
+void InstructionList::AddSymbol(const char* op, EAddressingMode addrMode, const Symbol* sym, uint16_t value)
+{
+    Add(op, addrMode, value, EInstructionRelocation::Symbol);
+    mInstructions.back().mSymbol = sym;
+}
+
+void InstructionList::AddLabel(const char* op, EAddressingMode addrMode, LabelID label)
+{
+    Add(op, addrMode, 0, EInstructionRelocation::Label);
+    mInstructions.back().mLabel = label;
+}
+
+uint16_t InstructionList::GetSize(const Instruction& instruction, const Emitter* emitter)
+{
+    // The emitter skips instructions it can't encode
+    if (instruction.IsLabel() || !emitter->HasAddressingMode(instruction.mOpcodeName.c_str(), instruction.mAddressingMode))
+        return 0;
+    return 1 + OpcodeTranslator::GetOperandLength(instruction.mAddressingMode);
+}
+
+uint16_t InstructionList::GetCodeSize(const Emitter* emitter) const
+{
+    uint16_t size = 0;
+    for (const Instruction& instruction : mInstructions)
+        size += GetSize(instruction, emitter);
+    return size;
+}
+
+void InstructionList::Resolve(Emitter* emitter, RelocationText& relocationText)
+{
+    // Place the labels
+    const uint16_t invalidAddress = 0xffff;
+    std::vector<uint16_t> labelAddresses(mLabelCount, invalidAddress);
+    uint16_t codeAddr = emitter->GetCurrentLocation();
+    for (const Instruction& instruction : mInstructions)
+    {
+        if (instruction.IsLabel())
+            labelAddresses[instruction.mLabel] = codeAddr;
+        codeAddr += GetSize(instruction, emitter);
+    }
+
+    // Encode
+    for (const Instruction& instruction : mInstructions)
+    {
+        if (instruction.IsLabel())
+            continue;
+
+        const char* op = instruction.mOpcodeName.c_str();
+        if (GetSize(instruction, emitter) == 0)
+        {
+            emitter->Emit(op, instruction.mAddressingMode, instruction.mValue); // reports the error
+            continue;
+        }
+
+        const size_t pos = emitter->GetCurrentLocation();
+        uint16_t value = instruction.mValue;
+
+        switch (instruction.mRelocation)
+        {
+        case EInstructionRelocation::None:
+            break;
+        case EInstructionRelocation::CodeAddress:
+            relocationText.mRelativeAddresses.push_back(pos + 1);
+            break;
+        case EInstructionRelocation::DataAddress:
+            if (OpcodeTranslator::GetOperandLength(instruction.mAddressingMode) == 1)
+                relocationText.mZeroPageDataAddresses.push_back({ pos + 1, value });
+            else
+                relocationText.mDataAddresses.push_back(pos + 1);
+            break;
+        case EInstructionRelocation::Symbol:
+            relocationText.mSymAddrRefs.push_back({ pos + 1, instruction.mSymbol->mUniqueName });
+            break;
+        case EInstructionRelocation::Label:
+        {
+            const uint16_t target = labelAddresses[instruction.mLabel];
+            if (target == invalidAddress)
+            {
+                LOG_ERROR() << "Unbound label " << instruction.mLabel << " referenced by " << op;
+                break;
+            }
+
+            if (instruction.IsBranch())
+            {
+                // Out of range branches are left to the linker, which turns them into an inverted branch over a JMP
+                const int displacement = static_cast<int>(target) - static_cast<int>(pos + 2);
+                value = (displacement >= -128 && displacement <= 127) ? static_cast<uint8_t>(displacement) : 0; // two's complement
+                relocationText.mBranchTargets.push_back({ pos, target });
+            }
+            else
+            {
+                value = target;
+                relocationText.mRelativeAddresses.push_back(pos + 1);
+            }
+            break;
+        }
+        }
+
+        emitter->Emit(op, instruction.mAddressingMode, value);
+    }
+
+    mInstructions.clear();
+    mLabelCount = 0;
+}
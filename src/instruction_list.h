@@ -0,0 +1,67 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "opcode.h"
+
+class Emitter;
+struct RelocationText;
+class Symbol;
+
+typedef uint32_t LabelID;
+
+enum class EInstructionRelocation
+{
+    None,
+    CodeAddress, // unit-local code address
+    DataAddress, // unit-local RAM address
+    Symbol,      // address of mSymbol (resolved by the linker)
+    Label        // code address of mLabel. Branches get the displacement instead.
+};
+
+/**
+* An instruction (or a label) that hasn't been encoded yet.
+*/
+struct Instruction
+{
+    std::string mOpcodeName; // empty for a label
+    EAddressingMode mAddressingMode = EAddressingMode::Implied;
+    uint16_t mValue = 0;
+    EInstructionRelocation mRelocation = EInstructionRelocation::None;
+    const Symbol* mSymbol = nullptr;
+    LabelID mLabel = 0;
+    bool mInlineAssembly = false; // written by the user, so never rewritten
+
+    bool IsLabel() const { return mOpcodeName.empty(); }
+    bool IsBranch() const;
+};
+
+/**
+* Instructions of a function, with symbolic branch and jump targets.
+* The code generator appends to it, and Resolve() places the labels and encodes the instructions
+*  at the end of the function, so nothing has to be patched afterwards.
+*/
+class InstructionList
+{
+private:
+    std::vector<Instruction> mInstructions;
+    LabelID mLabelCount = 0;
+
+    static uint16_t GetSize(const Instruction& instruction, const Emitter* emitter);
+
+public:
+    LabelID NewLabel() { return mLabelCount++; }
+    void BindLabel(LabelID label);
+
+    void Add(const char* op, EAddressingMode addrMode = EAddressingMode::Implied, uint16_t value = 0,
+        EInstructionRelocation relocation = EInstructionRelocation::None);
+    void AddSymbol(const char* op, EAddressingMode addrMode, const Symbol* sym, uint16_t value);
+    void AddLabel(const char* op, EAddressingMode addrMode, LabelID label);
+
+    std::vector<Instruction>& GetInstructions() { return mInstructions; }
+    // Bytes the instructions will take
+    uint16_t GetCodeSize(const Emitter* emitter) const;
+
+    // Emits the instructions and their relocations, and empties the list
+    void Resolve(Emitter* emitter, RelocationText& relocationText);
+};
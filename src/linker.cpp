@@ -2,21 +2,334 @@
 #include <cstdio>
 #include <fstream>
 #include <cstring>
+#include <algorithm>
+#include <unordered_set>
 
-Linker::Linker(Emitter* emitter)
+DataAllocator::DataAllocator()
+{
+    mFreeRanges.push_back({ 0x0000, 0x0100 }); // zero page
+    mFreeRanges.push_back({ 0x0200, 0x0800 }); // $0100-$01FF is the stack
+}
+
+bool DataAllocator::Allocate(uint16_t size, uint16_t alignment, bool zeroPage, uint16_t& outAddr)
+{
+    for (size_t iRange = 0; iRange < mFreeRanges.size(); ++iRange)
+    {
+        const uint16_t start = mFreeRanges[iRange].first;
+        const uint16_t end = mFreeRanges[iRange].second;
+        const uint16_t addr = (start + alignment - 1) / alignment * alignment;
+        if (addr + size > end || (zeroPage && addr + size > 0x0100))
+            continue;
+
+        outAddr = addr;
+        if (size == 0)
+            return true;
+
+        // Keep the padding and the remainder free
+        mFreeRanges.erase(mFreeRanges.begin() + iRange);
+        if (addr + size < end)
+            mFreeRanges.insert(mFreeRanges.begin() + iRange, { static_cast<uint16_t>(addr + size), end });
+        if (start < addr)
+            mFreeRanges.insert(mFreeRanges.begin() + iRange, { start, addr });
+        return true;
+    }
+    return false;
+}
+
+Linker::Linker(Emitter* emitter, const OpcodeTranslator* opcodeTranslator)
 {
     mEmitter = emitter;
+    mOpcodeTranslator = opcodeTranslator;
+}
+
+bool Linker::PlaceData(const std::vector<CompilationUnit*>& compUnits)
+{
+    // Data accessed with zero page operands first, then the hottest data, so it gets the rest of zero page.
+    //  Most aligned first among equals, to waste less space on padding. Ties are placed in link order, so the
+    //  layout doesn't depend on the order the units were compiled in.
+    std::vector<DataSymbol*> dataSymbols;
+    for (CompilationUnit* compUnit : compUnits)
+    {
+        for (DataSymbol& dataSym : compUnit->mRelocationText.mDataSymbols)
+            dataSymbols.push_back(&dataSym);
+    }
+    std::stable_sort(dataSymbols.begin(), dataSymbols.end(), [](const DataSymbol* a, const DataSymbol* b)
+    {
+        if (a->mZeroPage != b->mZeroPage)
+            return a->mZeroPage;
+        if (a->mWeight != b->mWeight)
+            return a->mWeight > b->mWeight;
+        return a->mAlignment > b->mAlignment;
+    });
+
+    DataAllocator dataAllocator;
+    size_t totalSize = 0;
+    for (DataSymbol* dataSym : dataSymbols)
+    {
+        totalSize += dataSym->mSize;
+        if (!dataAllocator.Allocate(dataSym->mSize, dataSym->mAlignment, dataSym->mZeroPage, dataSym->mAddress))
+        {
+            if (dataSym->mZeroPage)
+                printf("ERROR: Out of zero page RAM. Lower the zero page budget of the units (-zp).");
+            else
+                printf("ERROR: Out of RAM. %zu bytes of data needed.", totalSize);
+            return false;
+        }
+    }
+    return true;
+}
+
+uint16_t Linker::GetDataAddress(const CompilationUnit* compUnit, uint16_t localAddr)
+{
+    const std::vector<DataSymbol>& dataSymbols = compUnit->mRelocationText.mDataSymbols;
+    auto dataSymIter = std::upper_bound(dataSymbols.begin(), dataSymbols.end(), localAddr,
+        [](uint16_t addr, const DataSymbol& dataSym) { return addr < dataSym.mLocalAddress; });
+    if (dataSymIter == dataSymbols.begin())
+        return localAddr;
+    --dataSymIter;
+    return dataSymIter->mAddress + (localAddr - dataSymIter->mLocalAddress);
+}
+
+bool Linker::Relax(CompilationUnit* compUnit)
+{
+    std::vector<char>& code = compUnit->mObjectCode;
+    RelocationText& relocationText = compUnit->mRelocationText;
+    auto readAddress = [&code](size_t codeAddr)
+    {
+        uint16_t addr;
+        memcpy(&addr, &code[codeAddr], sizeof(uint16_t));
+        return addr;
+    };
+
+    // Final address of every absolute data operand, by operand position
+    std::unordered_map<size_t, uint16_t> dataOperands;
+    for (const size_t codeAddr : relocationText.mDataAddresses)
+        dataOperands[codeAddr] = GetDataAddress(compUnit, readAddress(codeAddr));
+    for (const auto& symRef : relocationText.mSymAddrRefs)
+    {
+        auto symIter = mSymbolTable.find(symRef.second);
+        if (symIter != mSymbolTable.end() && symIter->second->mSymbolType != ESymbolType::Function)
+            dataOperands[symRef.first] = symIter->second->mAddress;
+    }
+
+    // Targets of branches and of jumps inside the unit
+    std::unordered_map<size_t, uint16_t> branchTargets(relocationText.mBranchTargets.begin(), relocationText.mBranchTargets.end());
+    std::unordered_map<size_t, uint16_t> jumpTargets;
+    for (const size_t codeAddr : relocationText.mRelativeAddresses)
+        jumpTargets[codeAddr] = readAddress(codeAddr);
+
+    // Decode the code. It is only instructions, so it can be decoded from the start.
+    Opcode jmpOpcode;
+    mOpcodeTranslator->GetOpcode("JMP", EAddressingMode::Absolute, jmpOpcode);
+    struct Instruction
+    {
+        size_t mPos;
+        Opcode mOpcode;
+        uint16_t mLength;
+        uint16_t mNewLength;
+        int mTarget = -1; // branches: unit-local target
+        bool mShrink = false; // data operand in zero page
+        bool mLongBranch = false; // inverted branch over a JMP
+    };
+    std::vector<Instruction> instructions;
+    bool changed = false;
+    for (size_t pos = 0; pos < code.size();)
+    {
+        Instruction instruction;
+        instruction.mPos = pos;
+        if (!mOpcodeTranslator->GetOpcode(static_cast<uint8_t>(code[pos]), instruction.mOpcode))
+        {
+            // Branches and operands can't be fixed without knowing where the instructions are
+            printf("ERROR: Unknown opcode $%02x at $%04zx.", static_cast<uint8_t>(code[pos]), pos);
+            return false;
+        }
+        instruction.mLength = 1 + OpcodeTranslator::GetOperandLength(instruction.mOpcode.mAddressingMode);
+        instruction.mNewLength = instruction.mLength;
+
+        EAddressingMode zeroPageMode = instruction.mOpcode.mAddressingMode;
+        if (zeroPageMode == EAddressingMode::Absolute)
+            zeroPageMode = EAddressingMode::ZeroPage;
+        else if (zeroPageMode == EAddressingMode::AbsoluteX)
+            zeroPageMode = EAddressingMode::ZeroPageX;
+        else if (zeroPageMode == EAddressingMode::AbsoluteY)
+            zeroPageMode = EAddressingMode::ZeroPageY;
+
+        auto operandIter = dataOperands.find(pos + 1);
+        auto jumpIter = jumpTargets.find(pos + 1);
+        Opcode zeroPageOpcode;
+        if (zeroPageMode != instruction.mOpcode.mAddressingMode && operandIter != dataOperands.end()
+            && operandIter->second <= 0xff && mOpcodeTranslator->GetOpcode(instruction.mOpcode.mName, zeroPageMode, zeroPageOpcode))
+        {
+            instruction.mOpcode = zeroPageOpcode;
+            instruction.mShrink = true;
+            instruction.mNewLength--;
+            changed = true;
+        }
+        else if (instruction.mOpcode.mCode == jmpOpcode.mCode && jumpIter != jumpTargets.end() && jumpIter->second == pos + instruction.mLength)
+        {
+            // Jump to the next instruction
+            instruction.mNewLength = 0;
+            changed = true;
+        }
+        else if (OpcodeTranslator::IsBranch(instruction.mOpcode))
+        {
+            auto branchIter = branchTargets.find(pos);
+            if (branchIter != branchTargets.end())
+                instruction.mTarget = branchIter->second;
+            else
+                instruction.mTarget = static_cast<int>(pos) + 2 + static_cast<int8_t>(code[pos + 1]);
+            if (instruction.mTarget < 0 || instruction.mTarget > static_cast<int>(code.size()))
+                instruction.mTarget = -1;
+        }
+
+        instructions.push_back(instruction);
+        pos += instruction.mLength;
+    }
+    if (!instructions.empty() && instructions.back().mPos + instructions.back().mLength != code.size())
+    {
+        printf("ERROR: Last instruction at $%04zx is cut off.", instructions.back().mPos);
+        return false;
+    }
+
+    // Lay out the code, and make the branches that don't reach long until nothing changes.
+    //  Branches only ever grow, so this ends.
+    std::vector<uint16_t> newAddrs(code.size() + 1);
+    for (bool layoutChanged = true; layoutChanged;)
+    {
+        uint16_t newPos = 0;
+        for (const Instruction& instruction : instructions)
+        {
+            for (uint16_t i = 0; i < instruction.mLength; ++i)
+                newAddrs[instruction.mPos + i] = newPos + std::min(i, instruction.mNewLength);
+            newPos += instruction.mNewLength;
+        }
+        newAddrs[code.size()] = newPos;
+
+        layoutChanged = false;
+        for (Instruction& instruction : instructions)
+        {
+            if (instruction.mTarget < 0 || instruction.mLongBranch)
+                continue;
+            const int displacement = newAddrs[instruction.mTarget] - (newAddrs[instruction.mPos] + 2);
+            if (displacement < -128 || displacement > 127)
+            {
+                instruction.mLongBranch = true;
+                instruction.mNewLength = 2 + 3;
+                layoutChanged = true;
+                changed = true;
+            }
+            else if (static_cast<int8_t>(code[instruction.mPos + 1]) != displacement)
+                changed = true;
+        }
+    }
+    if (!changed)
+        return true;
+
+    std::vector<char> newCode;
+    std::vector<size_t> longBranchJumps; // operands of the JMPs of long branches
+    newCode.reserve(newAddrs[code.size()]);
+    for (const Instruction& instruction : instructions)
+    {
+        if (instruction.mNewLength == 0)
+            continue;
+
+        if (instruction.mShrink)
+        {
+            newCode.push_back(static_cast<char>(instruction.mOpcode.mCode));
+            newCode.push_back(static_cast<char>(dataOperands[instruction.mPos + 1]));
+        }
+        else if (instruction.mLongBranch)
+        {
+            // Bxx target -> (inverted Bxx) +3, JMP target
+            Opcode invertedOpcode;
+            mOpcodeTranslator->GetOpcode(OpcodeTranslator::GetInvertedBranch(instruction.mOpcode.mName), EAddressingMode::Immediate, invertedOpcode);
+            newCode.push_back(static_cast<char>(invertedOpcode.mCode));
+            newCode.push_back(3);
+            newCode.push_back(static_cast<char>(jmpOpcode.mCode));
+            longBranchJumps.push_back(newCode.size());
+            const uint16_t target = newAddrs[instruction.mTarget];
+            newCode.insert(newCode.end(), reinterpret_cast<const char*>(&target), reinterpret_cast<const char*>(&target) + sizeof(target));
+        }
+        else if (instruction.mTarget >= 0)
+        {
+            newCode.push_back(static_cast<char>(instruction.mOpcode.mCode));
+            newCode.push_back(static_cast<char>(newAddrs[instruction.mTarget] - (newAddrs[instruction.mPos] + 2)));
+        }
+        else
+            newCode.insert(newCode.end(), code.begin() + instruction.mPos, code.begin() + instruction.mPos + instruction.mLength);
+    }
+
+    // Move the relocations. Shrunk operands hold their final address already, and dropped jumps are gone.
+    std::unordered_set<size_t> removedOperands;
+    for (const Instruction& instruction : instructions)
+    {
+        if (instruction.mShrink || instruction.mNewLength == 0)
+            removedOperands.insert(instruction.mPos + 1);
+    }
+    auto isRemoved = [&removedOperands](size_t codeAddr) { return removedOperands.find(codeAddr) != removedOperands.end(); };
+
+    std::vector<size_t> dataAddresses;
+    for (const size_t codeAddr : relocationText.mDataAddresses)
+    {
+        if (!isRemoved(codeAddr))
+            dataAddresses.push_back(newAddrs[codeAddr]);
+    }
+    relocationText.mDataAddresses = dataAddresses;
+
+    std::vector<std::pair<size_t, std::string>> symAddrRefs;
+    for (const auto& symRef : relocationText.mSymAddrRefs)
+    {
+        if (!isRemoved(symRef.first))
+            symAddrRefs.push_back({ newAddrs[symRef.first], symRef.second });
+    }
+    relocationText.mSymAddrRefs = symAddrRefs;
+
+    for (auto& zeroPageRef : relocationText.mZeroPageDataAddresses)
+        zeroPageRef.first = newAddrs[zeroPageRef.first];
+
+    std::vector<size_t> relativeAddresses;
+    for (const size_t codeAddr : relocationText.mRelativeAddresses)
+    {
+        if (isRemoved(codeAddr))
+            continue;
+        const uint16_t target = readAddress(codeAddr);
+        relativeAddresses.push_back(newAddrs[codeAddr]);
+        if (target <= code.size())
+            memcpy(&newCode[newAddrs[codeAddr]], &newAddrs[target], sizeof(uint16_t));
+    }
+    relativeAddresses.insert(relativeAddresses.end(), longBranchJumps.begin(), longBranchJumps.end());
+    relocationText.mRelativeAddresses = relativeAddresses;
+
+    std::vector<std::pair<size_t, uint16_t>> branchTargetsAfter;
+    for (const Instruction& instruction : instructions)
+    {
+        if (instruction.mTarget >= 0 && !instruction.mLongBranch && branchTargets.find(instruction.mPos) != branchTargets.end())
+            branchTargetsAfter.push_back({ newAddrs[instruction.mPos], newAddrs[instruction.mTarget] });
+    }
+    relocationText.mBranchTargets = branchTargetsAfter;
+
+    for (auto symPair : compUnit->mSymbolTable)
+    {
+        Symbol* sym = symPair.second;
+        if (sym->mSymbolType == ESymbolType::Function && sym->mAddrType != ESymAddrType::None && sym->mAddress + sym->mSize <= code.size())
+        {
+            sym->mSize = newAddrs[sym->mAddress + sym->mSize] - newAddrs[sym->mAddress];
+            sym->mAddress = newAddrs[sym->mAddress];
+        }
+    }
+
+    code = newCode;
+    return true;
 }
 
 bool Linker::Link(const std::vector<CompilationUnit*> compUnits)
 {
-    // Collect symbols
-    size_t currCUPos = 0xc000;
+    if (!PlaceData(compUnits))
+        return false;
+
+    // Collect symbols (data addresses are final, code addresses are still unit-local)
     for (CompilationUnit* compUnit : compUnits)
     {
-        const size_t codeSize = compUnit->mObjectCode.size();
-        
-        // Collect symbols
         for (auto symPair : compUnit->mSymbolTable)
         {
             const ESymbolType symType = symPair.second->mSymbolType;
@@ -29,18 +342,57 @@ bool Linker::Link(const std::vector<CompilationUnit*> compUnits)
                 }
                 else
                 {
-                    if(symPair.second->mSymbolType == ESymbolType::Function)
-                        symPair.second->mAddress += currCUPos; // variable symbols (data symbols) are not offset
+                    if (symPair.second->mSymbolType != ESymbolType::Function)
+                        symPair.second->mAddress = GetDataAddress(compUnit, symPair.second->mAddress);
                     mSymbolTable.insert(symPair);
                 }
             }
         }
+    }
+
+    for (CompilationUnit* compUnit : compUnits)
+    {
+        if (!Relax(compUnit))
+            return false;
+    }
+
+    size_t currCUPos = 0xc000;
+    for (CompilationUnit* compUnit : compUnits)
+    {
+        const size_t codeSize = compUnit->mObjectCode.size();
+
+        for (auto symPair : compUnit->mSymbolTable)
+        {
+            if (symPair.second->mSymbolType == ESymbolType::Function && symPair.second->mAddrType != ESymAddrType::None)
+                symPair.second->mAddress += currCUPos;
+        }
 
         // Relocate relative addresses
         for (const size_t codeAddr : compUnit->mRelocationText.mRelativeAddresses)
         {
-            uint16_t* addrPtr = reinterpret_cast<uint16_t*>(&compUnit->mObjectCode[codeAddr]);
-            *addrPtr += currCUPos;
+            uint16_t addr;
+            memcpy(&addr, &compUnit->mObjectCode[codeAddr], sizeof(uint16_t));
+            addr += currCUPos;
+            memcpy(&compUnit->mObjectCode[codeAddr], &addr, sizeof(uint16_t));
+        }
+
+        // Relocate RAM addresses
+        for (const size_t codeAddr : compUnit->mRelocationText.mDataAddresses)
+        {
+            uint16_t localAddr;
+            memcpy(&localAddr, &compUnit->mObjectCode[codeAddr], sizeof(uint16_t));
+            const uint16_t addr = GetDataAddress(compUnit, localAddr);
+            memcpy(&compUnit->mObjectCode[codeAddr], &addr, sizeof(uint16_t));
+        }
+        for (const auto& zeroPageRef : compUnit->mRelocationText.mZeroPageDataAddresses)
+        {
+            const uint16_t addr = GetDataAddress(compUnit, zeroPageRef.second);
+            if (addr > 0xff)
+            {
+                printf("ERROR: Zero page operand refers to $%04x.", addr);
+                return false;
+            }
+            compUnit->mObjectCode[zeroPageRef.first] = static_cast<char>(addr);
         }
 
         currCUPos += codeSize;
@@ -4,15 +4,40 @@
 #include "emitter.h"
 #include <vector>
 
+/**
+* Places data in the 2KB internal RAM ($0000-$07FF), skipping the stack page.
+* First fit, so small data fills the gaps left by larger data (zero page first).
+*/
+class DataAllocator
+{
+private:
+    std::vector<std::pair<uint16_t, uint16_t>> mFreeRanges; // [start, end), by address
+
+public:
+    DataAllocator();
+    bool Allocate(uint16_t size, uint16_t alignment, bool zeroPage, uint16_t& outAddr);
+};
+
 class Linker
 {
 private:
     std::unordered_map<std::string, Symbol*> mSymbolTable;
     Emitter* mEmitter;
+    const OpcodeTranslator* mOpcodeTranslator;
+
+    bool PlaceData(const std::vector<CompilationUnit*>& compUnits);
+    static uint16_t GetDataAddress(const CompilationUnit* compUnit, uint16_t localAddr);
+    // Rewrites the code of a unit once data is placed:
+    //  - absolute data operands whose final address is in zero page are shrunk to the zero page form
+    //  - branches that can't reach their target become an inverted branch over a JMP
+    //  - jumps to the next instruction are dropped
+    // Fails if the code can't be decoded.
+    bool Relax(CompilationUnit* compUnit);
+
     bool WriteCode(const std::vector<CompilationUnit*> compUnits);
 
 public:
-    Linker(Emitter* emitter);
+    Linker(Emitter* emitter, const OpcodeTranslator* opcodeTranslator);
     bool Link(const std::vector<CompilationUnit*> compUnits);
     void WriteROM();
 };
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vector>
+#include "tokeniser.h"
+
+/**
+* A #define'd macro.
+* Function-like macros have a parameter list, and their body may use # (stringify) and ## (paste).
+*/
+struct Macro
+{
+    bool mFunctionLike = false;
+    std::vector<IdentifierID> mParameters;
+    std::vector<Token> mBody;
+
+    // Returns -1 if the name isn't a parameter
+    int GetParameterIndex(IdentifierID name) const
+    {
+        for (size_t i = 0; i < mParameters.size(); i++)
+        {
+            if (mParameters[i] == name)
+                return static_cast<int>(i);
+        }
+        return -1;
+    }
+};
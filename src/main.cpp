@@ -8,15 +8,136 @@
 #include "emitter.h"
 #include "opcode.h"
 #include "linker.h"
+#include "object_file.h"
+#include "build_cache.h"
+#include "debug.h"
 #include <vector>
 #include <cstring>
+#include <thread>
+#include <atomic>
+#include <algorithm>
 #include "preprocessor.h"
 
+struct CompileOptions
+{
+    std::string mPrecompiledHeader;
+    OpcodeTranslator* mOpcodeTranslator; // read-only, shared by all units
+    IdentifierTable* mIdentifierTable;
+    HeaderCache* mHeaderCache;
+    BuildCache* mBuildCache = nullptr;
+    uint16_t mZeroPageBudget = CodeGenerator::DefaultZeroPageBudget; // bytes of zero page per unit
+    std::atomic<size_t>* mPeepholeHits; // per rule, summed over the compiled units
+};
+
+// Runs the front-end and code generator on one input file. Safe to call from several threads at once.
+CompilationUnit* CompileUnit(const std::string& filePath, const CompileOptions& options)
+{
+    std::string fileDir = "";
+    const size_t last_slash_idx = filePath.find_last_of("\\/");
+    if (std::string::npos != last_slash_idx)
+    {
+       fileDir = filePath.substr(0, last_slash_idx);
+    }
+
+    const size_t errorCount = Debug::GetErrorCount();
+    CompilationUnit* compUnit = new CompilationUnit();
+    compUnit->mIdentifierTable = options.mIdentifierTable;
+    const SourceFile* sourceFile = compUnit->OpenSourceFile(filePath);
+    if (sourceFile == nullptr)
+    {
+        printf("Failed to open input file: %s\n", filePath.c_str());
+        delete compUnit;
+        return nullptr;
+    }
+
+    // Tokenise and preprocess (tokens are streamed to the parser)
+    Tokeniser tokeniser(sourceFile->GetData(), sourceFile->GetSize(), options.mIdentifierTable);
+    Preprocessor preprocessor(&tokeniser, fileDir, compUnit, options.mHeaderCache);
+    if (options.mPrecompiledHeader != "")
+        preprocessor.SetPrecompiledHeader(options.mPrecompiledHeader);
+
+    // With a build cache, the preprocessed tokens are collected first: the cache is keyed by them
+    std::vector<Token> tokens;
+    TokenListSource tokenListSource(tokens);
+    uint64_t cacheKey = 0;
+    if (options.mBuildCache != nullptr)
+    {
+        for (Token token = preprocessor.NextToken(); token.mTokenType != ETokenType::EndOfFile; token = preprocessor.NextToken())
+            tokens.push_back(token);
+
+        cacheKey = BuildCache::GetKey(tokens, options.mZeroPageBudget);
+        if (options.mBuildCache->Load(cacheKey, compUnit))
+            return compUnit;
+    }
+    TokenParser tokenParser(options.mBuildCache != nullptr ? static_cast<TokenSource*>(&tokenListSource) : &preprocessor);
+
+    // Parse
+    Parser parser(&tokenParser, compUnit);
+    parser.Parse();
+
+    // Analyse
+    Analyser analyser(compUnit);
+    analyser.Analyse();
+
+    // Compile (RAM addresses are unit-local until link time)
+    Emitter emitter(options.mOpcodeTranslator);
+    CodeGenerator generator(compUnit, &emitter, options.mZeroPageBudget);
+    generator.Generate();
+    for (size_t iRule = 0; iRule < static_cast<size_t>(EPeepholeRule::Count); ++iRule)
+        options.mPeepholeHits[iRule] += generator.GetPeephole().GetHits(static_cast<EPeepholeRule>(iRule));
+
+    size_t dataSize = emitter.GetDataSize();
+    compUnit->mObjectCode.resize(dataSize); // TODO
+    memcpy(compUnit->mObjectCode.data(), emitter.GetData(), dataSize);
+
+    // A unit with errors isn't cached, so its errors are reported again by the next build
+    if (Debug::GetErrorCount() != errorCount)
+        compUnit->mHasErrors = true;
+    if (options.mBuildCache != nullptr && !compUnit->mHasErrors)
+        options.mBuildCache->Store(cacheKey, compUnit);
+
+    return compUnit;
+}
+
+bool IsObjectFile(const std::string& filePath)
+{
+    return filePath.size() > 2 && filePath.compare(filePath.size() - 2, 2, ".o") == 0;
+}
+
+// <dir>/<name>.c -> <dir>/<name>.o
+std::string GetObjectFilePath(const std::string& filePath)
+{
+    const size_t last_slash_idx = filePath.find_last_of("\\/");
+    const size_t last_dot_idx = filePath.find_last_of('.');
+    if (last_dot_idx == std::string::npos || (last_slash_idx != std::string::npos && last_dot_idx < last_slash_idx))
+        return filePath + ".o";
+    return filePath.substr(0, last_dot_idx) + ".o";
+}
+
+CompilationUnit* LoadObjectFile(const std::string& filePath, const CompileOptions& options)
+{
+    CompilationUnit* compUnit = new CompilationUnit();
+    compUnit->mIdentifierTable = options.mIdentifierTable;
+    if (!ObjectFile::Read(filePath, compUnit))
+    {
+        printf("Failed to read object file: %s\n", filePath.c_str());
+        delete compUnit;
+        return nullptr;
+    }
+    return compUnit;
+}
+
 int main(int args, char** argv)
 {
     std::vector<std::string> inputFiles;
     std::string outputFile = "";
-    enum EArgParseMode { Input, Output } argParseMode = EArgParseMode::Input;
+    std::string precompiledHeader = "";
+    std::string cacheDirectory = "";
+    int numJobs = 1;
+    bool compileOnly = false; // -c: write an object file per input instead of linking
+    bool printStats = false; // -stats: print how often each peephole rule was applied
+    int zeroPageBudget = CodeGenerator::DefaultZeroPageBudget;
+    enum EArgParseMode { Input, Output, PrecompiledHeader, Jobs, CacheDirectory, ZeroPageBudget } argParseMode = EArgParseMode::Input;
 
     for (int i = 1; i < args; ++i)
     {
@@ -24,13 +145,47 @@ int main(int args, char** argv)
         {
             if (strcmp(argv[i], "-o") == 0)
                 argParseMode = EArgParseMode::Output;
+            else if (strcmp(argv[i], "-pch") == 0)
+                argParseMode = EArgParseMode::PrecompiledHeader;
+            else if (strcmp(argv[i], "-j") == 0)
+                argParseMode = EArgParseMode::Jobs;
+            else if (strcmp(argv[i], "-cache") == 0)
+                argParseMode = EArgParseMode::CacheDirectory;
+            else if (strcmp(argv[i], "-c") == 0)
+                compileOnly = true;
+            else if (strcmp(argv[i], "-stats") == 0)
+                printStats = true;
+            else if (strcmp(argv[i], "-zp") == 0)
+                argParseMode = EArgParseMode::ZeroPageBudget;
             else
                 inputFiles.push_back(argv[i]);
         }
+        else if (argParseMode == EArgParseMode::PrecompiledHeader)
+        {
+            precompiledHeader = argv[i];
+            argParseMode = EArgParseMode::Input;
+        }
+        else if (argParseMode == EArgParseMode::CacheDirectory)
+        {
+            cacheDirectory = argv[i];
+            argParseMode = EArgParseMode::Input;
+        }
+        else if (argParseMode == EArgParseMode::Jobs)
+        {
+            numJobs = atoi(argv[i]);
+            if (numJobs <= 0)
+                numJobs = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+            argParseMode = EArgParseMode::Input;
+        }
+        else if (argParseMode == EArgParseMode::ZeroPageBudget)
+        {
+            zeroPageBudget = std::min(std::max(atoi(argv[i]), 0), 0x100);
+            argParseMode = EArgParseMode::Input;
+        }
         else
             outputFile = argv[i];
     }
-    if (outputFile == "")
+    if (outputFile == "" && !compileOnly)
     {
         printf("No output file.\n");
         return 0;
@@ -40,57 +195,89 @@ int main(int args, char** argv)
         printf("No input files.\n");
         return 0;
     }
+    else if (compileOnly && outputFile != "" && inputFiles.size() > 1)
+    {
+        printf("-o can't be used with -c and several input files.\n");
+        return 0;
+    }
 
     OpcodeTranslator* opcodeTranslator = new OpcodeTranslator();
-    DataAllocator* dataAllocator = new DataAllocator();
+    IdentifierTable* identifierTable = new IdentifierTable();
+    HeaderCache* headerCache = new HeaderCache(identifierTable);
 
-    std::vector<CompilationUnit*> compilationUnits;
+    CompileOptions options;
+    options.mPrecompiledHeader = precompiledHeader;
+    options.mOpcodeTranslator = opcodeTranslator;
+    options.mIdentifierTable = identifierTable;
+    options.mHeaderCache = headerCache;
+    options.mZeroPageBudget = static_cast<uint16_t>(zeroPageBudget);
+    std::atomic<size_t> peepholeHits[static_cast<size_t>(EPeepholeRule::Count)] = {};
+    options.mPeepholeHits = peepholeHits;
+    if (cacheDirectory != "")
+        options.mBuildCache = new BuildCache(cacheDirectory);
 
-    for (size_t iSrc = 0; iSrc < inputFiles.size(); ++iSrc)
+    // Units are compiled in any order, but kept in input order so the link is deterministic
+    std::vector<CompilationUnit*> compilationUnits(inputFiles.size(), nullptr);
+    std::atomic<size_t> nextInput(0);
+    auto compileInputs = [&]()
     {
-        std::string filePath = inputFiles[iSrc];
-        std::ifstream fileStream(filePath);
-        std::string fileContents((std::istreambuf_iterator<char>(fileStream)), std::istreambuf_iterator<char>());
-
-        std::string fileDir = "";
-        const size_t last_slash_idx = filePath.find_last_of("\\/");
-        if (std::string::npos != last_slash_idx)
+        for (size_t iSrc = nextInput++; iSrc < inputFiles.size(); iSrc = nextInput++)
         {
-           fileDir = filePath.substr(0, last_slash_idx);
-        }
-
-        CompilationUnit* compUnit = new CompilationUnit();
-
-        // Tokenise
-        TokenParser tokenParser(fileContents.c_str());
-
-        // Tokenise
-        Preprocessor preprocessor(tokenParser, fileDir);
-        preprocessor.Preprocess();
+            const std::string& filePath = inputFiles[iSrc];
+            if (IsObjectFile(filePath) && compileOnly)
+                printf("Already an object file: %s\n", filePath.c_str());
+            else if (IsObjectFile(filePath))
+                compilationUnits[iSrc] = LoadObjectFile(filePath, options);
+            else
+                compilationUnits[iSrc] = CompileUnit(filePath, options);
 
-        // Parse
-        Parser parser(&tokenParser, compUnit);
-        parser.Parse();
+            if (compileOnly && compilationUnits[iSrc] != nullptr)
+            {
+                const std::string objectPath = outputFile != "" ? outputFile : GetObjectFilePath(filePath);
+                if (!ObjectFile::Write(objectPath, compilationUnits[iSrc]))
+                {
+                    printf("Failed to write object file: %s\n", objectPath.c_str());
+                    compilationUnits[iSrc] = nullptr;
+                }
+            }
+        }
+    };
 
-        // Analyse
-        Analyser analyser(compUnit);
-        analyser.Analyse();
+    const size_t numWorkers = std::min(static_cast<size_t>(numJobs), inputFiles.size());
+    if (numWorkers <= 1)
+        compileInputs();
+    else
+    {
+        std::vector<std::thread> workers;
+        for (size_t iWorker = 0; iWorker < numWorkers; ++iWorker)
+            workers.emplace_back(compileInputs);
+        for (std::thread& worker : workers)
+            worker.join();
+    }
 
-        compilationUnits.push_back(compUnit);
+    if (options.mBuildCache != nullptr)
+        printf("Build cache: %zu hits, %zu misses\n", options.mBuildCache->GetNumHits(), options.mBuildCache->GetNumMisses());
 
-        // Compile
-        Emitter emitter(opcodeTranslator);
-        CodeGenerator generator(compUnit, &emitter, dataAllocator);
-        generator.Generate();
+    // Only units compiled by this run are counted (not object files or cache hits)
+    if (printStats)
+    {
+        printf("Peephole:");
+        for (size_t iRule = 0; iRule < static_cast<size_t>(EPeepholeRule::Count); ++iRule)
+            printf("%s %s %zu", iRule > 0 ? "," : "", PeepholeOptimiser::GetRuleName(static_cast<EPeepholeRule>(iRule)), peepholeHits[iRule].load());
+        printf("\n");
+    }
 
-        size_t dataSize = emitter.GetDataSize();
-        compUnit->mObjectCode.resize(dataSize); // TODO
-        memcpy(compUnit->mObjectCode.data(), emitter.GetData(), dataSize);
+    for (CompilationUnit* compUnit : compilationUnits)
+    {
+        if (compUnit == nullptr)
+            return 0;
     }
+    if (compileOnly)
+        return 0;
 
     // Link
     Emitter emitter(opcodeTranslator);
-    Linker linker(&emitter);
+    Linker linker(&emitter, opcodeTranslator);
 
     if (linker.Link(compilationUnits))
     {
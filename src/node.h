@@ -1,9 +1,12 @@
 #pragma once
-#include <string>
+#include <string_view>
 
 #include "tokeniser.h"
+#include "operator.h"
 
-enum class ENodeType
+class Symbol; // fwd. decl.
+
+enum class ENodeType : uint8_t
 {
     Block,
     Statement,
@@ -13,22 +16,27 @@ enum class ENodeType
     InlineAssembly
 };
 
-enum class EStatementType
+enum class EStatementType : uint8_t
 {
     VariableDefinition, Expression, ReturnStatement, ControlStatement
 };
 
 /**
 * Node: Anything that can be parsed (statement, expression, etc)
+* Nodes are allocated in the arena of the CompilationUnit, and never destroyed.
+* Strings are views into the source files or the arena, and types are interned type names.
+* Names are resolved to symbols by the analyser, so code generation never looks symbols up by name.
+* The kind of node is stored in the node (no virtual dispatch), so passes switch on it directly.
 */
 class Node
 {
 public:
+    const ENodeType mNodeType;
     Node* mNext = nullptr;
 
-    virtual ~Node() {}
+    explicit Node(ENodeType nodeType) : mNodeType(nodeType) {}
 
-    virtual ENodeType GetNodeType() = 0;
+    ENodeType GetNodeType() const { return mNodeType; }
 };
 
 /**
@@ -40,23 +48,23 @@ class Block : public Node
 public:
     Node * mNode = nullptr;
 
-    virtual ENodeType GetNodeType() override { return ENodeType::Block; };
+    Block() : Node(ENodeType::Block) {}
 };
 
 
 /***** EXPRESSIONS *****/
 
-enum class EExpressionType
+enum class EExpressionType : uint8_t
 {
     BinaryOperation, UnaryOperation, Literal, Identifier, FunctionCall
 };
 
-enum class EUnaryExpressionType
+enum class EUnaryExpressionType : uint8_t
 {
     Prefixx, Postfix
 };
 
-enum class EIdentifierType
+enum class EIdentifierType : uint8_t
 {
     Variable, // ex: myInt
     StructMember, // ex: structInstance.memberVar
@@ -69,51 +77,61 @@ enum class EIdentifierType
 class Expression : public Node
 {
 public:
-    std::string mValueType;
+    const EExpressionType mExpressionType;
+    IdentifierID mValueType = InvalidIdentifierID; // interned type name (set by the analyser)
+    Symbol* mValueTypeSymbol = nullptr; // (set by the analyser)
+
+    explicit Expression(EExpressionType expressionType) : Node(ENodeType::Expression), mExpressionType(expressionType) {}
 
-    virtual EExpressionType GetExpressionType() const = 0;
-    virtual ENodeType GetNodeType() override { return ENodeType::Expression; };
+    EExpressionType GetExpressionType() const { return mExpressionType; }
 };
 
 class BinaryOperationExpression : public Expression
 {
 public:
-    std::string mOperator;
-    Expression* mLeftOperand;
-    Expression* mRightOperand;
-    virtual EExpressionType GetExpressionType() const override { return EExpressionType::BinaryOperation; }
+    EOperator mOperator = EOperator::None;
+    Expression* mLeftOperand = nullptr;
+    Expression* mRightOperand = nullptr;
+
+    BinaryOperationExpression() : Expression(EExpressionType::BinaryOperation) {}
 };
 
 class UnaryOperationExpression : public Expression
 {
 public:
-    std::string mOperator;
-    Expression* mOperand;
+    EOperator mOperator = EOperator::None;
+    Expression* mOperand = nullptr;
     EUnaryExpressionType mUnaryType;
-    virtual EExpressionType GetExpressionType() const override { return EExpressionType::UnaryOperation; }
+
+    UnaryOperationExpression() : Expression(EExpressionType::UnaryOperation) {}
 };
 
 class LiteralExpression : public Expression
 {
 public:
     Token mToken;
-    virtual EExpressionType GetExpressionType() const override { return EExpressionType::Literal; }
+
+    LiteralExpression() : Expression(EExpressionType::Literal) {}
 };
 
 class IdentifierExpression : public Expression
 {
 public:
-    std::string mIdentifier;
+    std::string_view mIdentifier;
     EIdentifierType mIdentifierType;
-    virtual EExpressionType GetExpressionType() const override { return EExpressionType::Identifier; }
+    Symbol* mSymbol = nullptr;
+
+    IdentifierExpression() : Expression(EExpressionType::Identifier) {}
 };
 
 class FunctionCallExpression : public Expression
 {
 public:
-    std::string mFunction;
+    std::string_view mFunction;
+    Symbol* mFunctionSymbol = nullptr;
     Expression* mParameters = nullptr;
-    virtual EExpressionType GetExpressionType() const override { return EExpressionType::FunctionCall; }
+
+    FunctionCallExpression() : Expression(EExpressionType::FunctionCall) {}
 };
 
 /***** STATEMENTS *****/
@@ -121,19 +139,21 @@ public:
 class Statement : public Node
 {
 public:
-    virtual EStatementType GetStatementType() const = 0;
+    const EStatementType mStatementType;
+
+    explicit Statement(EStatementType statementType) : Node(ENodeType::Statement), mStatementType(statementType) {}
 
-    virtual ENodeType GetNodeType() override { return ENodeType::Statement; };
+    EStatementType GetStatementType() const { return mStatementType; }
 };
 
 class ReturnStatement : public Statement
 {
 public:
-    std::string mFunction; // TODO: do we need this?
+    Symbol* mFunction = nullptr; // the function that returns
 
     Expression * mExpression = nullptr;
 
-    virtual EStatementType GetStatementType() const override { return EStatementType::ReturnStatement; };
+    ReturnStatement() : Statement(EStatementType::ReturnStatement) {}
 };
 
 /**
@@ -143,7 +163,8 @@ class ExpressionStatement : public Statement
 {
 public:
     Expression * mExpression = nullptr;
-    virtual EStatementType GetStatementType() const override { return EStatementType::Expression; };
+
+    ExpressionStatement() : Statement(EStatementType::Expression) {}
 };
 
 /**
@@ -152,10 +173,12 @@ public:
 class VarDefStatement : public Statement
 {
 public:
-    std::string mType;
-    std::string mName;
+    IdentifierID mType = InvalidIdentifierID;
+    std::string_view mName;
+    Symbol* mSymbol = nullptr;
     Expression* mExpression = nullptr;
-    virtual EStatementType GetStatementType() const override { return EStatementType::VariableDefinition; };
+
+    VarDefStatement() : Statement(EStatementType::VariableDefinition) {}
 };
 
 /**
@@ -173,36 +196,40 @@ public:
     Node* mBody = nullptr;
     // if => else
     Node* mConnectedStatement = nullptr;
-    virtual EStatementType GetStatementType() const override { return EStatementType::ControlStatement; };
+
+    ControlStatement() : Statement(EStatementType::ControlStatement) {}
 };
 
 
 class FunctionDefinition : public Node
 {
 public:
-    std::string mType;
-    std::string mName;
+    IdentifierID mType = InvalidIdentifierID;
+    std::string_view mName;
+    Symbol* mSymbol = nullptr;
     VarDefStatement* mParams = nullptr;
     Node* mContent = nullptr;
 
-    virtual ENodeType GetNodeType() override { return ENodeType::FunctionDefinition; };
+    FunctionDefinition() : Node(ENodeType::FunctionDefinition) {}
 };
 
 class StructDefinition : public Node
 {
 public:
-    std::string mName;
+    std::string_view mName;
+    Symbol* mSymbol = nullptr;
     Node* mContent = nullptr;
 
-    virtual ENodeType GetNodeType() override { return ENodeType::StructDefinition; };
+    StructDefinition() : Node(ENodeType::StructDefinition) {}
 };
 
 class InlineAssemblyStatement : public Node
 {
 public:
-    std::string mOpcodeName;
-    std::string mOp1;
-    std::string mOp2;
+    std::string_view mOpcodeName;
+    std::string_view mOp1;
+    std::string_view mOp2;
+    Symbol* mOp1Symbol = nullptr; // variable used as operand
 
-    virtual ENodeType GetNodeType() override { return ENodeType::InlineAssembly; };
+    InlineAssemblyStatement() : Node(ENodeType::InlineAssembly) {}
 };
@@ -0,0 +1,191 @@
+#include "object_file.h"
+#include "binary_stream.h"
+#include "source_file.h"
+#include <algorithm>
+
+namespace
+{
+    const char ObjectMagic[8] = { 'C', 'N', 'E', 'S', 'O', 'B', 'J', 0 };
+    const uint32_t ObjectVersion = 3;
+
+    bool IsLinkable(const Symbol* sym)
+    {
+        const ESymbolType symType = sym->mSymbolType;
+        return (symType == ESymbolType::Function || symType == ESymbolType::Variable || symType == ESymbolType::FuncParam) && sym->mAddrType != ESymAddrType::None;
+    }
+}
+
+bool ObjectFile::Write(const std::string& path, const CompilationUnit* compUnit)
+{
+    BinaryWriter writer;
+    writer.WriteBytes(ObjectMagic, sizeof(ObjectMagic));
+    writer.Write<uint32_t>(ObjectVersion);
+
+    writer.Write<uint32_t>(static_cast<uint32_t>(compUnit->mObjectCode.size()));
+    writer.WriteBytes(compUnit->mObjectCode.data(), compUnit->mObjectCode.size());
+
+    // Only the symbols the linker uses. Sorted, so the same unit always gives the same file.
+    std::vector<std::pair<std::string, const Symbol*>> symbols;
+    for (const auto& symPair : compUnit->mSymbolTable)
+    {
+        if (IsLinkable(symPair.second))
+            symbols.push_back({ symPair.first, symPair.second });
+    }
+    std::sort(symbols.begin(), symbols.end(),
+        [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    writer.Write<uint32_t>(static_cast<uint32_t>(symbols.size()));
+    for (const auto& symPair : symbols)
+    {
+        const Symbol* sym = symPair.second;
+        writer.WriteString(symPair.first);
+        writer.Write<uint8_t>(static_cast<uint8_t>(sym->mSymbolType));
+        writer.WriteString(sym->mName);
+        writer.WriteString(sym->mUniqueName);
+        writer.WriteString(sym->mTypeName);
+        writer.Write<uint8_t>(static_cast<uint8_t>(sym->mAddrType));
+        writer.Write<uint16_t>(sym->mAddress);
+        writer.Write<uint16_t>(sym->mSize);
+    }
+
+    const RelocationText& relocationText = compUnit->mRelocationText;
+    writer.Write<uint32_t>(static_cast<uint32_t>(relocationText.mSymAddrRefs.size()));
+    for (const auto& symRef : relocationText.mSymAddrRefs)
+    {
+        writer.Write<uint32_t>(static_cast<uint32_t>(symRef.first));
+        writer.WriteString(symRef.second);
+    }
+
+    writer.Write<uint32_t>(static_cast<uint32_t>(relocationText.mRelativeAddresses.size()));
+    for (const size_t codeAddr : relocationText.mRelativeAddresses)
+        writer.Write<uint32_t>(static_cast<uint32_t>(codeAddr));
+
+    writer.Write<uint32_t>(static_cast<uint32_t>(relocationText.mDataSymbols.size()));
+    for (const DataSymbol& dataSym : relocationText.mDataSymbols)
+    {
+        writer.Write<uint16_t>(dataSym.mLocalAddress);
+        writer.Write<uint16_t>(dataSym.mSize);
+        writer.Write<uint16_t>(dataSym.mAlignment);
+        writer.Write<uint8_t>(dataSym.mZeroPage ? 1 : 0);
+        writer.Write<uint32_t>(dataSym.mWeight);
+    }
+
+    writer.Write<uint32_t>(static_cast<uint32_t>(relocationText.mDataAddresses.size()));
+    for (const size_t codeAddr : relocationText.mDataAddresses)
+        writer.Write<uint32_t>(static_cast<uint32_t>(codeAddr));
+
+    writer.Write<uint32_t>(static_cast<uint32_t>(relocationText.mZeroPageDataAddresses.size()));
+    for (const auto& zeroPageRef : relocationText.mZeroPageDataAddresses)
+    {
+        writer.Write<uint32_t>(static_cast<uint32_t>(zeroPageRef.first));
+        writer.Write<uint16_t>(zeroPageRef.second);
+    }
+
+    writer.Write<uint32_t>(static_cast<uint32_t>(relocationText.mBranchTargets.size()));
+    for (const auto& branchTarget : relocationText.mBranchTargets)
+    {
+        writer.Write<uint32_t>(static_cast<uint32_t>(branchTarget.first));
+        writer.Write<uint16_t>(branchTarget.second);
+    }
+
+    return writer.WriteToFile(path);
+}
+
+bool ObjectFile::Read(const std::string& path, CompilationUnit* compUnit)
+{
+    SourceFile file;
+    if (!file.Open(path))
+        return false;
+
+    BinaryReader reader(file.GetData(), file.GetSize());
+    char magic[sizeof(ObjectMagic)];
+    reader.ReadBytes(magic, sizeof(magic));
+    if (memcmp(magic, ObjectMagic, sizeof(ObjectMagic)) != 0 || reader.Read<uint32_t>() != ObjectVersion)
+        return false;
+
+    const uint32_t codeSize = reader.Read<uint32_t>();
+    if (codeSize > file.GetSize())
+        return false;
+    compUnit->mObjectCode.resize(codeSize);
+    reader.ReadBytes(compUnit->mObjectCode.data(), codeSize);
+
+    const uint32_t numSymbols = reader.Read<uint32_t>();
+    for (uint32_t i = 0; i < numSymbols && !reader.HasFailed(); ++i)
+    {
+        const std::string key(reader.ReadString());
+        Symbol* sym = new Symbol();
+        sym->mSymbolType = static_cast<ESymbolType>(reader.Read<uint8_t>());
+        sym->mName = reader.ReadString();
+        sym->mUniqueName = reader.ReadString();
+        sym->mTypeName = reader.ReadString();
+        sym->mAddrType = static_cast<ESymAddrType>(reader.Read<uint8_t>());
+        sym->mAddress = reader.Read<uint16_t>();
+        sym->mSize = reader.Read<uint16_t>();
+        compUnit->mSymbolTable[key] = sym;
+    }
+
+    RelocationText& relocationText = compUnit->mRelocationText;
+    const uint32_t numSymAddrRefs = reader.Read<uint32_t>();
+    for (uint32_t i = 0; i < numSymAddrRefs && !reader.HasFailed(); ++i)
+    {
+        const size_t codeAddr = reader.Read<uint32_t>();
+        relocationText.mSymAddrRefs.push_back({ codeAddr, std::string(reader.ReadString()) });
+    }
+
+    const uint32_t numRelativeAddresses = reader.Read<uint32_t>();
+    for (uint32_t i = 0; i < numRelativeAddresses && !reader.HasFailed(); ++i)
+        relocationText.mRelativeAddresses.push_back(reader.Read<uint32_t>());
+
+    const uint32_t numDataSymbols = reader.Read<uint32_t>();
+    for (uint32_t i = 0; i < numDataSymbols && !reader.HasFailed(); ++i)
+    {
+        DataSymbol dataSym;
+        dataSym.mLocalAddress = reader.Read<uint16_t>();
+        dataSym.mSize = reader.Read<uint16_t>();
+        dataSym.mAlignment = reader.Read<uint16_t>();
+        dataSym.mZeroPage = reader.Read<uint8_t>() != 0;
+        dataSym.mWeight = reader.Read<uint32_t>();
+        relocationText.mDataSymbols.push_back(dataSym);
+    }
+
+    const uint32_t numDataAddresses = reader.Read<uint32_t>();
+    for (uint32_t i = 0; i < numDataAddresses && !reader.HasFailed(); ++i)
+        relocationText.mDataAddresses.push_back(reader.Read<uint32_t>());
+
+    const uint32_t numZeroPageDataAddresses = reader.Read<uint32_t>();
+    for (uint32_t i = 0; i < numZeroPageDataAddresses && !reader.HasFailed(); ++i)
+    {
+        const size_t codeAddr = reader.Read<uint32_t>();
+        relocationText.mZeroPageDataAddresses.push_back({ codeAddr, reader.Read<uint16_t>() });
+    }
+
+    const uint32_t numBranchTargets = reader.Read<uint32_t>();
+    for (uint32_t i = 0; i < numBranchTargets && !reader.HasFailed(); ++i)
+    {
+        const size_t codeAddr = reader.Read<uint32_t>();
+        relocationText.mBranchTargets.push_back({ codeAddr, reader.Read<uint16_t>() });
+    }
+
+    if (reader.HasFailed() || !reader.IsAtEnd())
+        return false;
+
+    // Relocations must stay inside the code
+    auto isInCode = [codeSize](size_t codeAddr) { return codeAddr + 2 <= codeSize; };
+    for (const auto& symRef : relocationText.mSymAddrRefs)
+    {
+        if (!isInCode(symRef.first))
+            return false;
+    }
+    for (const auto& zeroPageRef : relocationText.mZeroPageDataAddresses)
+    {
+        if (zeroPageRef.first + 1 > codeSize)
+            return false;
+    }
+    for (const auto& branchTarget : relocationText.mBranchTargets)
+    {
+        if (branchTarget.first + 2 > codeSize || branchTarget.second > codeSize)
+            return false;
+    }
+    return std::all_of(relocationText.mRelativeAddresses.begin(), relocationText.mRelativeAddresses.end(), isInCode)
+        && std::all_of(relocationText.mDataAddresses.begin(), relocationText.mDataAddresses.end(), isInCode);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+#include "compilation_unit.h"
+
+/**
+* Relocatable object file: the object code of a compilation unit, its linkable symbols and its relocation records.
+* Written by separate compilation (-c), and read back into a CompilationUnit that the Linker links like a compiled one.
+*/
+class ObjectFile
+{
+public:
+    static bool Write(const std::string& path, const CompilationUnit* compUnit);
+    static bool Read(const std::string& path, CompilationUnit* compUnit);
+};
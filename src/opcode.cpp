@@ -7,6 +7,7 @@
     op.mAddressingMode = addrmode;\
     op.mCode = index;\
     mOpcodeMap.emplace(std::pair<std::string, EAddressingMode>(name, addrmode), op);\
+    mBinaryOpcodeMap.emplace(index, op);\
 }
 
 OpcodeTranslator::OpcodeTranslator()
@@ -26,7 +27,7 @@ OpcodeTranslator::OpcodeTranslator()
     SET_OPCODE(0x15, "ORA", EAddressingMode::ZeroPageX);
     SET_OPCODE(0x16, "ASL", EAddressingMode::ZeroPageX);
     SET_OPCODE(0x18, "CLC", EAddressingMode::Implied);
-    SET_OPCODE(0x19, "ORA", EAddressingMode::AbsoluteX);
+    SET_OPCODE(0x19, "ORA", EAddressingMode::AbsoluteY);
     SET_OPCODE(0x1D, "ORA", EAddressingMode::AbsoluteX);
     SET_OPCODE(0x1E, "ASL", EAddressingMode::AbsoluteX);
 
@@ -47,7 +48,7 @@ OpcodeTranslator::OpcodeTranslator()
     SET_OPCODE(0x35, "AND", EAddressingMode::ZeroPageX);
     SET_OPCODE(0x36, "ROL", EAddressingMode::ZeroPageX);
     SET_OPCODE(0x38, "SEC", EAddressingMode::Implied);
-    SET_OPCODE(0x39, "AND", EAddressingMode::AbsoluteX);
+    SET_OPCODE(0x39, "AND", EAddressingMode::AbsoluteY);
     SET_OPCODE(0x3D, "AND", EAddressingMode::AbsoluteX);
     SET_OPCODE(0x3E, "ROL", EAddressingMode::AbsoluteX);
 
@@ -191,6 +192,44 @@ bool OpcodeTranslator::GetOpcode(const std::string& op, const EAddressingMode ad
         return false;
 }
 
+uint16_t OpcodeTranslator::GetOperandLength(const EAddressingMode addrMode)
+{
+    switch (addrMode)
+    {
+    case EAddressingMode::Absolute:
+    case EAddressingMode::AbsoluteX:
+    case EAddressingMode::AbsoluteY:
+    case EAddressingMode::Indirect:
+        return 2;
+    case EAddressingMode::Accumulator:
+    case EAddressingMode::Implied:
+        return 0;
+    default:
+        return 1;
+    }
+}
+
+bool OpcodeTranslator::IsBranch(const Opcode& opcode)
+{
+    // Relative addressing is stored as Immediate, and no other B* instruction has an immediate form
+    return opcode.mAddressingMode == EAddressingMode::Immediate && opcode.mName[0] == 'B';
+}
+
+const char* OpcodeTranslator::GetInvertedBranch(const std::string& branch)
+{
+    static const std::pair<const char*, const char*> InvertedBranches[] =
+    {
+        { "BEQ", "BNE" }, { "BNE", "BEQ" }, { "BCC", "BCS" }, { "BCS", "BCC" },
+        { "BPL", "BMI" }, { "BMI", "BPL" }, { "BVC", "BVS" }, { "BVS", "BVC" },
+    };
+    for (const auto& invertedBranch : InvertedBranches)
+    {
+        if (branch == invertedBranch.first)
+            return invertedBranch.second;
+    }
+    return "";
+}
+
 bool OpcodeTranslator::GetOpcode(int value, Opcode& outOpcode) const
 {
     auto it = mBinaryOpcodeMap.find(value);
@@ -2,6 +2,7 @@
 
 #include <string>
 #include <map>
+#include <stdint.h>
 
 enum EAddressingMode
 {
@@ -37,4 +38,9 @@ public:
 
     bool GetOpcode(const std::string& op, const EAddressingMode addrMode, Opcode& outOpcode) const;
     bool GetOpcode(int value, Opcode& outOpcode) const;
+
+    static uint16_t GetOperandLength(const EAddressingMode addrMode);
+    static bool IsBranch(const Opcode& opcode);
+    // Branch taken when the given one isn't (ex: BEQ -> BNE), or "" if not a branch
+    static const char* GetInvertedBranch(const std::string& branch);
 };
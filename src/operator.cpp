@@ -0,0 +1,29 @@
+#include "operator.h"
+
+const char* GetOperatorString(EOperator op)
+{
+    switch (op)
+    {
+    case EOperator::Increment: return "++";
+    case EOperator::Decrement: return "--";
+    case EOperator::Not: return "!";
+    case EOperator::Plus: return "+";
+    case EOperator::Minus: return "-";
+    case EOperator::Star: return "*";
+    case EOperator::Slash: return "/";
+    case EOperator::Arrow: return "->";
+    case EOperator::Greater: return ">";
+    case EOperator::Less: return "<";
+    case EOperator::GreaterEqual: return ">=";
+    case EOperator::LessEqual: return "<=";
+    case EOperator::Equal: return "==";
+    case EOperator::NotEqual: return "!=";
+    case EOperator::LogicalAnd: return "&&";
+    case EOperator::LogicalXor: return "^^";
+    case EOperator::LogicalOr: return "||";
+    case EOperator::Assign: return "=";
+    case EOperator::AddAssign: return "+=";
+    case EOperator::SubtractAssign: return "-=";
+    default: return "";
+    }
+}
@@ -1,6 +1,7 @@
 #pragma once
 
-#include <string>
+#include <stddef.h>
+#include <stdint.h>
 
 enum class EOperatorAssociativity
 {
@@ -8,10 +9,111 @@ enum class EOperatorAssociativity
     RightToLeft
 };
 
+// Operators, classified by the tokeniser
+enum class EOperator : uint8_t
+{
+    None,
+    Increment,      // ++
+    Decrement,      // --
+    Not,            // !
+    Plus,           // +
+    Minus,          // -
+    Star,           // *
+    Slash,          // /
+    Arrow,          // ->
+    Greater,        // >
+    Less,           // <
+    GreaterEqual,   // >=
+    LessEqual,      // <=
+    Equal,          // ==
+    NotEqual,       // !=
+    LogicalAnd,     // &&
+    LogicalXor,     // ^^
+    LogicalOr,      // ||
+    Assign,         // =
+    AddAssign,      // +=
+    SubtractAssign, // -=
+    Count
+};
+
 class OperatorInfo
 {
 public:
-    std::string mOperator;
-    int mPrecedence;
-    EOperatorAssociativity mAssociativity;
+    EOperator mOperator = EOperator::None;
+    int mPrecedence = 0; // 0 = not an operator of this kind
+    EOperatorAssociativity mAssociativity = EOperatorAssociativity::LeftToRight;
 };
+
+const char* GetOperatorString(EOperator op);
+
+namespace OperatorTables
+{
+    constexpr size_t NumOperators = static_cast<size_t>(EOperator::Count);
+
+    /**
+    * The operators of the language, and their precedence (lower value = binds tighter), indexed by EOperator.
+    * Shared by the parser and the preprocessor (#if expressions).
+    */
+    struct Tables
+    {
+        OperatorInfo mUnaryPrefix[NumOperators];
+        OperatorInfo mUnaryPostfix[NumOperators];
+        OperatorInfo mBinary[NumOperators];
+    };
+
+    constexpr void SetOperator(OperatorInfo* table, EOperator op, int precedence, EOperatorAssociativity associativity)
+    {
+        table[static_cast<size_t>(op)] = OperatorInfo{ op, precedence, associativity };
+    }
+
+    constexpr Tables BuildTables()
+    {
+        Tables tables{};
+
+        // Unary prefix operators
+        SetOperator(tables.mUnaryPrefix, EOperator::Increment, 3, EOperatorAssociativity::LeftToRight);
+        SetOperator(tables.mUnaryPrefix, EOperator::Decrement, 3, EOperatorAssociativity::LeftToRight);
+        SetOperator(tables.mUnaryPrefix, EOperator::Not, 3, EOperatorAssociativity::LeftToRight);
+        SetOperator(tables.mUnaryPrefix, EOperator::Plus, 3, EOperatorAssociativity::LeftToRight);
+        SetOperator(tables.mUnaryPrefix, EOperator::Minus, 3, EOperatorAssociativity::LeftToRight);
+
+        // Unary postfix operators
+        SetOperator(tables.mUnaryPostfix, EOperator::Increment, 2, EOperatorAssociativity::LeftToRight);
+        SetOperator(tables.mUnaryPostfix, EOperator::Decrement, 2, EOperatorAssociativity::LeftToRight);
+        SetOperator(tables.mUnaryPostfix, EOperator::Star, 3, EOperatorAssociativity::RightToLeft);
+
+        // Binary operators
+        SetOperator(tables.mBinary, EOperator::Arrow, 2, EOperatorAssociativity::LeftToRight);
+        SetOperator(tables.mBinary, EOperator::Star, 4, EOperatorAssociativity::LeftToRight);
+        SetOperator(tables.mBinary, EOperator::Slash, 4, EOperatorAssociativity::LeftToRight);
+        SetOperator(tables.mBinary, EOperator::Plus, 5, EOperatorAssociativity::LeftToRight);
+        SetOperator(tables.mBinary, EOperator::Minus, 5, EOperatorAssociativity::LeftToRight);
+        SetOperator(tables.mBinary, EOperator::Greater, 7, EOperatorAssociativity::LeftToRight);
+        SetOperator(tables.mBinary, EOperator::Less, 7, EOperatorAssociativity::LeftToRight);
+        SetOperator(tables.mBinary, EOperator::GreaterEqual, 7, EOperatorAssociativity::LeftToRight);
+        SetOperator(tables.mBinary, EOperator::LessEqual, 7, EOperatorAssociativity::LeftToRight);
+        SetOperator(tables.mBinary, EOperator::Equal, 8, EOperatorAssociativity::LeftToRight);
+        SetOperator(tables.mBinary, EOperator::NotEqual, 8, EOperatorAssociativity::LeftToRight);
+        SetOperator(tables.mBinary, EOperator::LogicalAnd, 12, EOperatorAssociativity::LeftToRight);
+        SetOperator(tables.mBinary, EOperator::LogicalXor, 13, EOperatorAssociativity::LeftToRight);
+        SetOperator(tables.mBinary, EOperator::LogicalOr, 14, EOperatorAssociativity::LeftToRight);
+        SetOperator(tables.mBinary, EOperator::Assign, 16, EOperatorAssociativity::LeftToRight);
+        SetOperator(tables.mBinary, EOperator::AddAssign, 16, EOperatorAssociativity::LeftToRight);
+        SetOperator(tables.mBinary, EOperator::SubtractAssign, 16, EOperatorAssociativity::LeftToRight);
+
+        return tables;
+    }
+
+    inline constexpr Tables kTables = BuildTables();
+
+    inline const OperatorInfo* Find(const OperatorInfo* table, EOperator op)
+    {
+        const OperatorInfo& info = table[static_cast<size_t>(op)];
+        return info.mPrecedence != 0 ? &info : nullptr;
+    }
+}
+
+// Return nullptr if not an operator of that kind
+inline const OperatorInfo* FindUnaryPrefixOperator(EOperator op) { return OperatorTables::Find(OperatorTables::kTables.mUnaryPrefix, op); }
+inline const OperatorInfo* FindUnaryPostfixOperator(EOperator op) { return OperatorTables::Find(OperatorTables::kTables.mUnaryPostfix, op); }
+inline const OperatorInfo* FindBinaryOperator(EOperator op) { return OperatorTables::Find(OperatorTables::kTables.mBinary, op); }
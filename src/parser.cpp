@@ -4,37 +4,6 @@
 
 Parser::Parser(TokenParser* tokenParser, CompilationUnit* compilationUnit)
 {
-    // Unary prefix operators
-    mUnaryPrefixOperatorsMap.emplace("++", OperatorInfo{ "++", 3, EOperatorAssociativity::LeftToRight });
-    mUnaryPrefixOperatorsMap.emplace("--", OperatorInfo{ "--", 3, EOperatorAssociativity::LeftToRight });
-    mUnaryPrefixOperatorsMap.emplace("!", OperatorInfo{ "!", 3, EOperatorAssociativity::LeftToRight });
-    mUnaryPrefixOperatorsMap.emplace("+", OperatorInfo{ "+", 3, EOperatorAssociativity::LeftToRight });
-    mUnaryPrefixOperatorsMap.emplace("-", OperatorInfo{ "-", 3, EOperatorAssociativity::LeftToRight });
-
-    // Unary postfix operators
-    mUnaryPostfixOperatorsMap.emplace("++", OperatorInfo{ "++", 2, EOperatorAssociativity::LeftToRight });
-    mUnaryPostfixOperatorsMap.emplace("--", OperatorInfo{ "--", 2, EOperatorAssociativity::LeftToRight });
-    mUnaryPostfixOperatorsMap.emplace("*", OperatorInfo{ "*", 3, EOperatorAssociativity::RightToLeft });
-
-    // Binary operators
-    mBinaryOperatorsMap.emplace("->", OperatorInfo{ "->", 2, EOperatorAssociativity::LeftToRight });
-    mBinaryOperatorsMap.emplace("*", OperatorInfo{ "*", 4, EOperatorAssociativity::LeftToRight });
-    mBinaryOperatorsMap.emplace("/", OperatorInfo{ "/", 4, EOperatorAssociativity::LeftToRight });
-    mBinaryOperatorsMap.emplace("+", OperatorInfo{ "+", 5, EOperatorAssociativity::LeftToRight });
-    mBinaryOperatorsMap.emplace("-", OperatorInfo{ "-", 5, EOperatorAssociativity::LeftToRight });
-    mBinaryOperatorsMap.emplace(">", OperatorInfo{ ">", 7, EOperatorAssociativity::LeftToRight });
-    mBinaryOperatorsMap.emplace("<", OperatorInfo{ "<", 7, EOperatorAssociativity::LeftToRight });
-    mBinaryOperatorsMap.emplace(">=", OperatorInfo{ ">=", 7, EOperatorAssociativity::LeftToRight });
-    mBinaryOperatorsMap.emplace("<=", OperatorInfo{ "<=", 7, EOperatorAssociativity::LeftToRight });
-    mBinaryOperatorsMap.emplace("==", OperatorInfo{ "==", 8, EOperatorAssociativity::LeftToRight });
-    mBinaryOperatorsMap.emplace("!=", OperatorInfo{ "!=", 8, EOperatorAssociativity::LeftToRight });
-    mBinaryOperatorsMap.emplace("&&", OperatorInfo{ "&&", 12, EOperatorAssociativity::LeftToRight });
-    mBinaryOperatorsMap.emplace("^^", OperatorInfo{ "^^", 13, EOperatorAssociativity::LeftToRight });
-    mBinaryOperatorsMap.emplace("||", OperatorInfo{ "||", 14, EOperatorAssociativity::LeftToRight });
-    mBinaryOperatorsMap.emplace("=", OperatorInfo{ "=", 16, EOperatorAssociativity::LeftToRight });
-    mBinaryOperatorsMap.emplace("+=", OperatorInfo{ "+=", 16, EOperatorAssociativity::LeftToRight });
-    mBinaryOperatorsMap.emplace("-=", OperatorInfo{ "-=", 16, EOperatorAssociativity::LeftToRight });
-
 	mNoOperandOpcodes.insert("clc");
 	mNoOperandOpcodes.insert("sei");
 	mNoOperandOpcodes.insert("inx");
@@ -46,14 +15,14 @@ Parser::Parser(TokenParser* tokenParser, CompilationUnit* compilationUnit)
 
 Parser::EParseResult Parser::ParseBinaryOperator(OperatorInfo& outOperator)
 {
-    Token currToken = mTokenParser->GetCurrentToken();
+    const Token& currToken = mTokenParser->GetCurrentToken();
     if (currToken.mTokenType != ETokenType::Operator)
         return EParseResult::NotParsed;
 
-    auto opIter = mBinaryOperatorsMap.find(currToken.mTokenString);
-    if (opIter != mBinaryOperatorsMap.end())
+    const OperatorInfo* opInfo = FindBinaryOperator(currToken.mOperator);
+    if (opInfo != nullptr)
     {
-        outOperator = opIter->second;
+        outOperator = *opInfo;
         mTokenParser->Advance();
         return EParseResult::Parsed;
     }
@@ -62,14 +31,14 @@ Parser::EParseResult Parser::ParseBinaryOperator(OperatorInfo& outOperator)
 
 Parser::EParseResult Parser::ParseUnaryPostfixOperator(OperatorInfo& outOperator)
 {
-    Token currToken = mTokenParser->GetCurrentToken();
+    const Token& currToken = mTokenParser->GetCurrentToken();
     if (currToken.mTokenType != ETokenType::Operator)
         return EParseResult::NotParsed;
 
-    auto opIter = mUnaryPostfixOperatorsMap.find(currToken.mTokenString);
-    if (opIter != mUnaryPostfixOperatorsMap.end())
+    const OperatorInfo* opInfo = FindUnaryPostfixOperator(currToken.mOperator);
+    if (opInfo != nullptr)
     {
-        outOperator = opIter->second;
+        outOperator = *opInfo;
         mTokenParser->Advance();
         return EParseResult::Parsed;
     }
@@ -78,14 +47,14 @@ Parser::EParseResult Parser::ParseUnaryPostfixOperator(OperatorInfo& outOperator
 
 Parser::EParseResult Parser::ParseUnaryPrefixOperator(OperatorInfo& outOperator)
 {
-    Token currToken = mTokenParser->GetCurrentToken();
+    const Token& currToken = mTokenParser->GetCurrentToken();
     if (currToken.mTokenType != ETokenType::Operator)
         return EParseResult::NotParsed;
 
-    auto opIter = mUnaryPrefixOperatorsMap.find(currToken.mTokenString);
-    if (opIter != mUnaryPrefixOperatorsMap.end())
+    const OperatorInfo* opInfo = FindUnaryPrefixOperator(currToken.mOperator);
+    if (opInfo != nullptr)
     {
-        outOperator = opIter->second;
+        outOperator = *opInfo;
         mTokenParser->Advance();
         return EParseResult::Parsed;
     }
@@ -108,7 +77,7 @@ Parser::EParseResult Parser::ParseAtom(Expression** outExpression)
     case ETokenType::FloatLiteral:
     case ETokenType::IntegerLiteral:
     {
-        atomExpression = new LiteralExpression();
+        atomExpression = mCompilationUnit->mArena.New<LiteralExpression>();
         ((LiteralExpression*)atomExpression)->mToken = currToken;
         mTokenParser->Advance();
         break;
@@ -136,7 +105,7 @@ Parser::EParseResult Parser::ParseAtom(Expression** outExpression)
     {
         if (mTokenParser->GetTokenFromOffset(1).mTokenString == "(")
         {
-            FunctionCallExpression* funcCallExpr = new FunctionCallExpression();
+            FunctionCallExpression* funcCallExpr = mCompilationUnit->mArena.New<FunctionCallExpression>();
             funcCallExpr->mFunction = currToken.mTokenString;
             Expression** currParamExpr = &funcCallExpr->mParameters;
             mTokenParser->Advance();
@@ -153,7 +122,7 @@ Parser::EParseResult Parser::ParseAtom(Expression** outExpression)
         }
         else
         {
-            IdentifierExpression* identifierExpression = new IdentifierExpression();
+            IdentifierExpression* identifierExpression = mCompilationUnit->mArena.New<IdentifierExpression>();
             identifierExpression->mIdentifier = currToken.mTokenString;
             atomExpression = identifierExpression;
             mTokenParser->Advance();
@@ -173,7 +142,7 @@ Parser::EParseResult Parser::ParseAtom(Expression** outExpression)
 
     if (prefixOpRes == EParseResult::Parsed)
     {
-        UnaryOperationExpression* unaryExpr = new UnaryOperationExpression();
+        UnaryOperationExpression* unaryExpr = mCompilationUnit->mArena.New<UnaryOperationExpression>();
         unaryExpr->mOperator = prefixOp.mOperator;
         unaryExpr->mOperand = atomExpression;
         unaryExpr->mUnaryType = EUnaryExpressionType::Prefixx;
@@ -182,7 +151,7 @@ Parser::EParseResult Parser::ParseAtom(Expression** outExpression)
 
     if (postfixOpRes == EParseResult::Parsed)
     {
-        UnaryOperationExpression* unaryExpr = new UnaryOperationExpression();
+        UnaryOperationExpression* unaryExpr = mCompilationUnit->mArena.New<UnaryOperationExpression>();
         unaryExpr->mOperator = postfixOp.mOperator;
         unaryExpr->mOperand = atomExpression;
         unaryExpr->mUnaryType = EUnaryExpressionType::Postfix;
@@ -206,7 +175,6 @@ Parser::EParseResult Parser::ParseExpression(const OperatorInfo& inOperator, Exp
     while (true)
     {
         // Parse operator
-        Token operatorToken = mTokenParser->GetCurrentToken();
         OperatorInfo operatorInfo;
         EParseResult binaryOpRes = ParseBinaryOperator(operatorInfo);
         if (binaryOpRes == EParseResult::Parsed)
@@ -217,7 +185,7 @@ Parser::EParseResult Parser::ParseExpression(const OperatorInfo& inOperator, Exp
                 EParseResult subExprParseResult = ParseExpression(operatorInfo, &rightExpr);
                 if (subExprParseResult == EParseResult::Parsed)
                 {
-                    BinaryOperationExpression* opExpr = new BinaryOperationExpression();
+                    BinaryOperationExpression* opExpr = mCompilationUnit->mArena.New<BinaryOperationExpression>();
                     opExpr->mOperator = operatorInfo.mOperator;
                     opExpr->mLeftOperand = *outExpression;
                     opExpr->mRightOperand = rightExpr;
@@ -251,7 +219,7 @@ Parser::EParseResult Parser::ParseExpressionStatement(Node** outNode)
         return EParseResult::NotParsed;
 
     // Create node
-    ExpressionStatement* exprStmNode = new ExpressionStatement();
+    ExpressionStatement* exprStmNode = mCompilationUnit->mArena.New<ExpressionStatement>();
     *outNode = exprStmNode;
 
     // Parse assignment expression
@@ -271,7 +239,7 @@ Parser::EParseResult Parser::ParseBlock(Node** outNode)
 {
     if (mTokenParser->GetCurrentToken().mTokenString == "{")
     {
-        Block* blockNode = new Block();
+        Block* blockNode = mCompilationUnit->mArena.New<Block>();
         *outNode = blockNode;
         mTokenParser->Advance();
         Node** currNodePtr = &blockNode->mNode;
@@ -302,7 +270,7 @@ Parser::EParseResult Parser::ParseReturnStatement(Node** outNode)
 
     mTokenParser->Advance();
 
-    ReturnStatement* retStatement = new ReturnStatement();
+    ReturnStatement* retStatement = mCompilationUnit->mArena.New<ReturnStatement>();
     *outNode = retStatement;
 
     // Parse return value expression
@@ -336,8 +304,8 @@ Parser::EParseResult Parser::ParseVariableDefinition(Node** outNode)
     mTokenParser->Advance();
 
     // Create node
-    VarDefStatement* varDefNode = new VarDefStatement();
-    varDefNode->mType = typeToken.mTokenString;
+    VarDefStatement* varDefNode = mCompilationUnit->mArena.New<VarDefStatement>();
+    varDefNode->mType = typeToken.mIdentifierID;
     varDefNode->mName = nameToken.mTokenString;
     *outNode = varDefNode;
 
@@ -400,7 +368,7 @@ Parser::EParseResult Parser::ParseControlStatement(Node** outNode)
 
     mTokenParser->Advance();
 
-    ControlStatement* ctrlStmNode = new ControlStatement();
+    ControlStatement* ctrlStmNode = mCompilationUnit->mArena.New<ControlStatement>();
     ctrlStmNode->mControlStatementType = ctrlStmType;
     *outNode = ctrlStmNode;
 
@@ -504,9 +472,9 @@ Parser::EParseResult Parser::ParseFunctionDefinition(Node** outNode)
     mTokenParser->Advance(); // (
     mTokenParser->Advance(); // first param, or )
 
-    FunctionDefinition* funcDefNode = new FunctionDefinition();
+    FunctionDefinition* funcDefNode = mCompilationUnit->mArena.New<FunctionDefinition>();
     *outNode = funcDefNode;
-    funcDefNode->mType = typeToken.mTokenString;
+    funcDefNode->mType = typeToken.mIdentifierID;
     funcDefNode->mName = nameToken.mTokenString;
 
     // Parse function parameters
@@ -529,8 +497,8 @@ Parser::EParseResult Parser::ParseFunctionDefinition(Node** outNode)
         if (paramDelimiter.mTokenString != ")")
             mTokenParser->Advance();
 
-        VarDefStatement* param = new VarDefStatement();
-        param->mType = paramIdentifier.mTokenString;
+        VarDefStatement* param = mCompilationUnit->mArena.New<VarDefStatement>();
+        param->mType = paramIdentifier.mIdentifierID;
         param->mName = paramName.mTokenString;
         *currParamNode = param;
         currParamNode = &param->mNext;
@@ -566,7 +534,7 @@ Parser::EParseResult Parser::ParseFunctionDefinition(Node** outNode)
     else
     {
         // TODO: Delete node ???
-        OnError("Expected { but found: " + mTokenParser->GetCurrentToken().mTokenString);
+        OnError("Expected { but found: " + std::string(mTokenParser->GetCurrentToken().mTokenString));
         return EParseResult::Error;
     }
 
@@ -587,12 +555,12 @@ Parser::EParseResult Parser::ParseStructDefinition(Node** outNode)
 
     if (structNameToken.mTokenType != ETokenType::Identifier)
     {
-        OnError("Invalid struct name: " + structNameToken.mTokenString);
+        OnError("Invalid struct name: " + std::string(structNameToken.mTokenString));
         return EParseResult::Error;
     }
 
     // Create Node
-    StructDefinition* structDefNode = new StructDefinition();
+    StructDefinition* structDefNode = mCompilationUnit->mArena.New<StructDefinition>();
     structDefNode->mName = structNameToken.mTokenString;
     *outNode = structDefNode;
 
@@ -638,7 +606,7 @@ Parser::EParseResult Parser::ParseStructDefinition(Node** outNode)
     }
     else
     {
-        OnError("Expected { but found: " + mTokenParser->GetCurrentToken().mTokenString);
+        OnError("Expected { but found: " + std::string(mTokenParser->GetCurrentToken().mTokenString));
         return EParseResult::Error;
     }
 }
@@ -652,7 +620,7 @@ Parser::EParseResult Parser::ParseInlineAssembly(Node** outNode)
 
     mTokenParser->Advance();
 
-    InlineAssemblyStatement* node = new InlineAssemblyStatement();
+    InlineAssemblyStatement* node = mCompilationUnit->mArena.New<InlineAssemblyStatement>();
     *outNode = node;
     
     // TODO: Indirect addressing mode
@@ -664,14 +632,15 @@ Parser::EParseResult Parser::ParseInlineAssembly(Node** outNode)
 	if (mNoOperandOpcodes.find(node->mOpcodeName) == mNoOperandOpcodes.end())
 	{
 		node->mOp1 = mTokenParser->GetCurrentToken().mTokenString;
+		mTokenParser->Advance();
 
+		// Index register (ex: LDA $10, x)
 		if (mTokenParser->GetCurrentToken().mTokenString == ",")
 		{
 			mTokenParser->Advance();
 			node->mOp2 = mTokenParser->GetCurrentToken().mTokenString;
+			mTokenParser->Advance();
 		}
-
-		mTokenParser->Advance();
 	}
 
     return EParseResult::Parsed;
@@ -707,14 +676,14 @@ Parser::EParseResult Parser::ParseNextNode(Node** outNode)
         }
 
         // If we got here, we failed to parse a node
-        OnError("Undefined identifier: " + token.mTokenString);
+        OnError("Undefined identifier: " + std::string(token.mTokenString));
         return EParseResult::Error;
 
         break;
     }
     default:
     {
-        OnError("Unexpected token: " + token.mTokenString);
+        OnError("Unexpected token: " + std::string(token.mTokenString));
         return EParseResult::Error;
         break;
     }
@@ -722,7 +691,7 @@ Parser::EParseResult Parser::ParseNextNode(Node** outNode)
 }
 
 /// FOR DEBUGGING
-void PrintNodes(Node* node, int indents)
+void PrintNodes(Node* node, int indents, const IdentifierTable* identifierTable)
 {
     std::string indentString = "";
     for (int i = 0; i < indents; i++)
@@ -731,42 +700,63 @@ void PrintNodes(Node* node, int indents)
     Node* currNode = node;
     while (currNode != nullptr)
     {
-        if (StructDefinition* structNode = dynamic_cast<StructDefinition*>(currNode))
-        {
-            LOG_INFO() << indentString << "Struct: " << structNode->mName;
-            PrintNodes(structNode->mContent, indents+1);
-        }
-        else if (FunctionDefinition* funcNode = dynamic_cast<FunctionDefinition*>(currNode))
+        switch (currNode->GetNodeType())
         {
-            LOG_INFO() << indentString << "Function: " << funcNode->mType << " " << funcNode->mName;
-            PrintNodes(funcNode->mParams, indents + 1);
-            PrintNodes(funcNode->mContent, indents + 1);
-        }
-        else if (VarDefStatement* varDefNode = dynamic_cast<VarDefStatement*>(currNode))
+        case ENodeType::StructDefinition:
         {
-            LOG_INFO() << indentString << "Variable: " << varDefNode->mType << " " << varDefNode->mName;
-            if (varDefNode->mExpression != nullptr)
-                LOG_INFO() << indentString << " =";
-            PrintNodes(varDefNode->mExpression, indents + 1);
+            StructDefinition* structNode = static_cast<StructDefinition*>(currNode);
+            LOG_INFO() << indentString << "Struct: " << structNode->mName;
+            PrintNodes(structNode->mContent, indents + 1, identifierTable);
+            break;
         }
-        else if (LiteralExpression* literalExpr = dynamic_cast<LiteralExpression*>(currNode))
+        case ENodeType::FunctionDefinition:
         {
-            LOG_INFO() << indentString << literalExpr->mToken.mTokenString;
+            FunctionDefinition* funcNode = static_cast<FunctionDefinition*>(currNode);
+            LOG_INFO() << indentString << "Function: " << identifierTable->GetName(funcNode->mType) << " " << funcNode->mName;
+            PrintNodes(funcNode->mParams, indents + 1, identifierTable);
+            PrintNodes(funcNode->mContent, indents + 1, identifierTable);
+            break;
         }
-        else if (IdentifierExpression* varExpr = dynamic_cast<IdentifierExpression*>(currNode))
+        case ENodeType::Statement:
         {
-            LOG_INFO() << indentString << varExpr->mIdentifier;
+            Statement* statement = static_cast<Statement*>(currNode);
+            if (statement->GetStatementType() == EStatementType::VariableDefinition)
+            {
+                VarDefStatement* varDefNode = static_cast<VarDefStatement*>(statement);
+                LOG_INFO() << indentString << "Variable: " << identifierTable->GetName(varDefNode->mType) << " " << varDefNode->mName;
+                if (varDefNode->mExpression != nullptr)
+                    LOG_INFO() << indentString << " =";
+                PrintNodes(varDefNode->mExpression, indents + 1, identifierTable);
+            }
+            else if (statement->GetStatementType() == EStatementType::ReturnStatement)
+            {
+                LOG_INFO() << "return";
+                PrintNodes(static_cast<ReturnStatement*>(statement)->mExpression, indents + 1, identifierTable);
+            }
+            break;
         }
-        else if (BinaryOperationExpression* binExpr = dynamic_cast<BinaryOperationExpression*>(currNode))
+        case ENodeType::Expression:
         {
-            PrintNodes(binExpr->mLeftOperand, indents);
-            LOG_INFO() << indentString << binExpr->mOperator;
-            PrintNodes(binExpr->mRightOperand, indents);
+            Expression* expression = static_cast<Expression*>(currNode);
+            if (expression->GetExpressionType() == EExpressionType::Literal)
+            {
+                LOG_INFO() << indentString << static_cast<LiteralExpression*>(expression)->mToken.mTokenString;
+            }
+            else if (expression->GetExpressionType() == EExpressionType::Identifier)
+            {
+                LOG_INFO() << indentString << static_cast<IdentifierExpression*>(expression)->mIdentifier;
+            }
+            else if (expression->GetExpressionType() == EExpressionType::BinaryOperation)
+            {
+                BinaryOperationExpression* binExpr = static_cast<BinaryOperationExpression*>(expression);
+                PrintNodes(binExpr->mLeftOperand, indents, identifierTable);
+                LOG_INFO() << indentString << GetOperatorString(binExpr->mOperator);
+                PrintNodes(binExpr->mRightOperand, indents, identifierTable);
+            }
+            break;
         }
-        else if (ReturnStatement* retStatement = dynamic_cast<ReturnStatement*>(currNode))
-        {
-            LOG_INFO() << "return";
-            PrintNodes(retStatement->mExpression, indents + 1);
+        default:
+            break;
         }
 
         currNode = currNode->mNext;
@@ -791,7 +781,7 @@ void Parser::Parse()
             return;
     }
 
-    PrintNodes(mCompilationUnit->mRootNode, 0);
+    PrintNodes(mCompilationUnit->mRootNode, 0, mCompilationUnit->mIdentifierTable);
 }
 
 void Parser::OnError(const std::string& errorString)
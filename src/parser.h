@@ -23,12 +23,9 @@ private:
     TokenParser* mTokenParser;
     CompilationUnit* mCompilationUnit;
 
-    std::unordered_map<std::string, OperatorInfo> mUnaryPrefixOperatorsMap;
-    std::unordered_map<std::string, OperatorInfo> mUnaryPostfixOperatorsMap;
-    std::unordered_map<std::string, OperatorInfo> mBinaryOperatorsMap;
-	std::set<std::string> mNoOperandOpcodes;
+	std::set<std::string, std::less<>> mNoOperandOpcodes;
 
-    OperatorInfo mDefaultOuterOperatorInfo = { "", 999, EOperatorAssociativity::LeftToRight };
+    OperatorInfo mDefaultOuterOperatorInfo = { EOperator::None, 999, EOperatorAssociativity::LeftToRight };
 
     EParseResult ParseBinaryOperator(OperatorInfo& outOperator);
     EParseResult ParseUnaryPostfixOperator(OperatorInfo& outOperator);
@@ -0,0 +1,193 @@
+#include "peephole.h"
+#include <cstring>
+
+namespace
+{
+    // Instructions the rules may look at. Inline assembly is left exactly as the user wrote it.
+    bool IsCompiled(const std::vector<Instruction>& instructions, size_t index)
+    {
+        return index < instructions.size() && !instructions[index].IsLabel() && !instructions[index].mInlineAssembly;
+    }
+
+    bool IsOp(const std::vector<Instruction>& instructions, size_t index, const char* op)
+    {
+        return IsCompiled(instructions, index) && instructions[index].mOpcodeName == op;
+    }
+
+    bool IsLabel(const std::vector<Instruction>& instructions, size_t index, LabelID label)
+    {
+        return index < instructions.size() && instructions[index].IsLabel() && instructions[index].mLabel == label;
+    }
+
+    bool IsLabelRef(const std::vector<Instruction>& instructions, size_t index)
+    {
+        return IsCompiled(instructions, index) && instructions[index].mRelocation == EInstructionRelocation::Label;
+    }
+
+    bool IsImmediate(const std::vector<Instruction>& instructions, size_t index, const char* op, uint16_t value)
+    {
+        return IsOp(instructions, index, op) && instructions[index].mAddressingMode == EAddressingMode::Immediate
+            && instructions[index].mRelocation == EInstructionRelocation::None && instructions[index].mValue == value;
+    }
+
+    bool SameOperand(const Instruction& a, const Instruction& b)
+    {
+        return a.mAddressingMode == b.mAddressingMode && a.mValue == b.mValue && a.mRelocation == b.mRelocation && a.mSymbol == b.mSymbol;
+    }
+
+    // Instructions reading and writing each other's label
+    size_t CountReferences(const std::vector<Instruction>& instructions, LabelID label)
+    {
+        size_t numRefs = 0;
+        for (const Instruction& instruction : instructions)
+            numRefs += !instruction.IsLabel() && instruction.mRelocation == EInstructionRelocation::Label && instruction.mLabel == label;
+        return numRefs;
+    }
+
+    // Sets N and Z without reading them
+    bool OverwritesFlags(const std::vector<Instruction>& instructions, size_t index)
+    {
+        static const char* const FlagSetters[] =
+        {
+            "LDA", "LDX", "LDY", "AND", "ORA", "EOR", "ADC", "SBC", "CMP", "CPX", "CPY",
+            "TAX", "TAY", "TXA", "TYA", "INX", "INY", "DEX", "DEY", "PLA",
+        };
+        if (!IsCompiled(instructions, index))
+            return false;
+        for (const char* op : FlagSetters)
+        {
+            if (instructions[index].mOpcodeName == op)
+                return true;
+        }
+        return false;
+    }
+
+    // STA x; LDA x -> STA x. If N and Z are used before being set again, the load becomes AND #$FF.
+    bool ApplyStoreLoad(std::vector<Instruction>& instructions, size_t index)
+    {
+        static const std::pair<const char*, const char*> StoreLoads[] = { { "STA", "LDA" }, { "STX", "LDX" }, { "STY", "LDY" } };
+        for (const auto& storeLoad : StoreLoads)
+        {
+            if (!IsOp(instructions, index, storeLoad.first) || !IsOp(instructions, index + 1, storeLoad.second))
+                continue;
+
+            // Only RAM reads back what was written (not I/O registers)
+            const Instruction& store = instructions[index];
+            const bool isRam = store.mRelocation == EInstructionRelocation::DataAddress || store.mRelocation == EInstructionRelocation::Symbol;
+            if (!isRam || !SameOperand(store, instructions[index + 1]))
+                return false;
+
+            if (OverwritesFlags(instructions, index + 2))
+                instructions.erase(instructions.begin() + index + 1);
+            else if (strcmp(storeLoad.first, "STA") == 0)
+                instructions[index + 1] = Instruction{ "AND", EAddressingMode::Immediate, 0xff };
+            else
+                return false; // CPX/CPY #0 would also change C
+            return true;
+        }
+        return false;
+    }
+
+    // JMP L; L: -> L:
+    bool ApplyJumpToNext(std::vector<Instruction>& instructions, size_t index)
+    {
+        if (!IsOp(instructions, index, "JMP") || !IsLabelRef(instructions, index))
+            return false;
+
+        for (size_t next = index + 1; next < instructions.size() && instructions[next].IsLabel(); ++next)
+        {
+            if (instructions[next].mLabel == instructions[index].mLabel)
+            {
+                instructions.erase(instructions.begin() + index);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // A comparison turned into 0/1, then tested: branch on the comparison instead.
+    //  Bcc T; LDA #0; JMP E; T: LDA #1; E: BEQ F -> B!cc F
+    bool ApplyBooleanBranch(std::vector<Instruction>& instructions, size_t index)
+    {
+        if (!IsLabelRef(instructions, index) || !instructions[index].IsBranch())
+            return false;
+
+        const LabelID trueLabel = instructions[index].mLabel;
+        if (!IsImmediate(instructions, index + 1, "LDA", 0) || !IsOp(instructions, index + 2, "JMP") || !IsLabelRef(instructions, index + 2))
+            return false;
+        const LabelID endLabel = instructions[index + 2].mLabel;
+        if (!IsLabel(instructions, index + 3, trueLabel) || !IsImmediate(instructions, index + 4, "LDA", 1) || !IsLabel(instructions, index + 5, endLabel))
+            return false;
+
+        // BEQ jumps when the comparison failed (A == 0), BNE when it succeeded
+        const bool jumpOnFalse = IsOp(instructions, index + 6, "BEQ");
+        if ((!jumpOnFalse && !IsOp(instructions, index + 6, "BNE")) || !IsLabelRef(instructions, index + 6))
+            return false;
+
+        // Nothing else may jump into the sequence
+        if (CountReferences(instructions, trueLabel) != 1 || CountReferences(instructions, endLabel) != 1)
+            return false;
+
+        Instruction branch = instructions[index + 6];
+        branch.mOpcodeName = jumpOnFalse ? OpcodeTranslator::GetInvertedBranch(instructions[index].mOpcodeName) : instructions[index].mOpcodeName;
+        instructions[index] = branch;
+        instructions.erase(instructions.begin() + index + 1, instructions.begin() + index + 7);
+        return true;
+    }
+
+    // RTS; RTS -> RTS
+    bool ApplyDuplicateReturn(std::vector<Instruction>& instructions, size_t index)
+    {
+        if (!IsOp(instructions, index, "RTS") || !IsOp(instructions, index + 1, "RTS"))
+            return false;
+        instructions.erase(instructions.begin() + index + 1);
+        return true;
+    }
+
+    struct PeepholeRule
+    {
+        EPeepholeRule mRule;
+        const char* mName;
+        // Rewrites the instructions starting at index, if they match
+        bool (*mApply)(std::vector<Instruction>& instructions, size_t index);
+    };
+
+    const PeepholeRule PeepholeRules[] =
+    {
+        { EPeepholeRule::StoreLoad, "store/load", ApplyStoreLoad },
+        { EPeepholeRule::JumpToNext, "jump to next", ApplyJumpToNext },
+        { EPeepholeRule::BooleanBranch, "boolean branch", ApplyBooleanBranch },
+        { EPeepholeRule::DuplicateReturn, "duplicate RTS", ApplyDuplicateReturn },
+    };
+}
+
+const char* PeepholeOptimiser::GetRuleName(EPeepholeRule rule)
+{
+    for (const PeepholeRule& peepholeRule : PeepholeRules)
+    {
+        if (peepholeRule.mRule == rule)
+            return peepholeRule.mName;
+    }
+    return "";
+}
+
+void PeepholeOptimiser::Optimise(std::vector<Instruction>& instructions)
+{
+    // A rewrite can make another rule match (ex: removing a jump puts two RTS next to each other)
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (size_t index = 0; index < instructions.size(); ++index)
+        {
+            for (const PeepholeRule& peepholeRule : PeepholeRules)
+            {
+                if (peepholeRule.mApply(instructions, index))
+                {
+                    ++mHits[static_cast<size_t>(peepholeRule.mRule)];
+                    changed = true;
+                }
+            }
+        }
+    }
+}
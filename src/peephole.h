@@ -0,0 +1,31 @@
+#pragma once
+#include <stddef.h>
+#include <vector>
+#include "instruction_list.h"
+
+enum class EPeepholeRule
+{
+    StoreLoad,       // STA x; LDA x
+    JumpToNext,      // JMP L; L:
+    BooleanBranch,   // BEQ T; LDA #0; JMP E; T: LDA #1; E: BEQ F
+    DuplicateReturn, // RTS; RTS
+    Count
+};
+
+/**
+* Pattern-driven rewrites of an instruction list, before it's encoded.
+* Each rule of the table is tried at every instruction, until none of them applies anymore.
+*/
+class PeepholeOptimiser
+{
+private:
+    size_t mHits[static_cast<size_t>(EPeepholeRule::Count)] = {};
+
+public:
+    static const char* GetRuleName(EPeepholeRule rule);
+
+    void Optimise(std::vector<Instruction>& instructions);
+
+    // Times the rule was applied
+    size_t GetHits(EPeepholeRule rule) const { return mHits[static_cast<size_t>(rule)]; }
+};
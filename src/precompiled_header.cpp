@@ -0,0 +1,147 @@
+#include "precompiled_header.h"
+#include "binary_stream.h"
+#include "hash.h"
+
+namespace
+{
+    const char PCHMagic[8] = { 'C', 'N', 'E', 'S', 'P', 'C', 'H', 0 };
+    const uint32_t PCHVersion = 3;
+
+    void WriteToken(BinaryWriter& writer, const Token& token)
+    {
+        writer.Write<uint8_t>(static_cast<uint8_t>(token.mTokenType));
+        writer.WriteString(token.mTokenString);
+        writer.Write<uint8_t>(static_cast<uint8_t>(token.mOperator));
+        writer.Write<int32_t>(token.mIntValue);
+        writer.Write<float>(token.mFloatValue);
+        writer.Write<int32_t>(token.mLineNumber);
+    }
+
+    Token ReadToken(BinaryReader& reader, IdentifierTable* identifierTable)
+    {
+        Token token;
+        token.mTokenType = static_cast<ETokenType>(reader.Read<uint8_t>());
+        token.mTokenString = reader.ReadString();
+        token.mOperator = static_cast<EOperator>(reader.Read<uint8_t>());
+        token.mIntValue = reader.Read<int32_t>();
+        token.mFloatValue = reader.Read<float>();
+        token.mLineNumber = reader.Read<int32_t>();
+        if (token.mTokenType == ETokenType::Identifier)
+            token.mIdentifierID = identifierTable->Intern(token.mTokenString);
+        return token;
+    }
+
+    void WriteMacro(BinaryWriter& writer, const Macro& macro, const IdentifierTable* identifierTable)
+    {
+        writer.Write<uint8_t>(macro.mFunctionLike ? 1 : 0);
+        writer.Write<uint32_t>(static_cast<uint32_t>(macro.mParameters.size()));
+        for (const IdentifierID parameter : macro.mParameters)
+            writer.WriteString(identifierTable->GetName(parameter));
+        writer.Write<uint32_t>(static_cast<uint32_t>(macro.mBody.size()));
+        for (const Token& token : macro.mBody)
+            WriteToken(writer, token);
+    }
+
+    Macro ReadMacro(BinaryReader& reader, IdentifierTable* identifierTable)
+    {
+        Macro macro;
+        macro.mFunctionLike = reader.Read<uint8_t>() != 0;
+        const uint32_t numParameters = reader.Read<uint32_t>();
+        for (uint32_t i = 0; i < numParameters && !reader.HasFailed(); ++i)
+            macro.mParameters.push_back(identifierTable->Intern(reader.ReadString()));
+        const uint32_t numBodyTokens = reader.Read<uint32_t>();
+        for (uint32_t i = 0; i < numBodyTokens && !reader.HasFailed(); ++i)
+            macro.mBody.push_back(ReadToken(reader, identifierTable));
+        return macro;
+    }
+}
+
+std::string PrecompiledHeader::GetPCHPath(const std::string& headerPath)
+{
+    return headerPath + ".pch";
+}
+
+bool PrecompiledHeader::Write(const std::string& path, const IdentifierTable* identifierTable) const
+{
+    BinaryWriter writer;
+    writer.WriteBytes(PCHMagic, sizeof(PCHMagic));
+    writer.Write<uint32_t>(PCHVersion);
+
+    writer.Write<uint32_t>(static_cast<uint32_t>(mDependencies.size()));
+    for (const Dependency& dependency : mDependencies)
+    {
+        writer.WriteString(dependency.mPath);
+        writer.Write<uint64_t>(dependency.mContentHash);
+    }
+
+    writer.Write<uint32_t>(static_cast<uint32_t>(mTokens.size()));
+    for (const Token& token : mTokens)
+        WriteToken(writer, token);
+
+    writer.Write<uint32_t>(static_cast<uint32_t>(mDefinitions.size()));
+    for (const auto& definition : mDefinitions)
+    {
+        writer.WriteString(identifierTable->GetName(definition.first));
+        WriteMacro(writer, definition.second, identifierTable);
+    }
+
+    writer.Write<uint32_t>(static_cast<uint32_t>(mPragmaOnceFiles.size()));
+    for (const std::string& pragmaOnceFile : mPragmaOnceFiles)
+        writer.WriteString(pragmaOnceFile);
+
+    return writer.WriteToFile(path);
+}
+
+bool PrecompiledHeader::Read(const std::string& path, IdentifierTable* identifierTable, std::shared_ptr<SourceFile>& outSourceFile)
+{
+    std::shared_ptr<SourceFile> sourceFile = std::make_shared<SourceFile>();
+    if (!sourceFile->Open(path))
+        return false;
+
+    BinaryReader reader(sourceFile->GetData(), sourceFile->GetSize());
+    char magic[sizeof(PCHMagic)];
+    reader.ReadBytes(magic, sizeof(magic));
+    if (memcmp(magic, PCHMagic, sizeof(PCHMagic)) != 0 || reader.Read<uint32_t>() != PCHVersion)
+        return false;
+
+    const uint32_t numDependencies = reader.Read<uint32_t>();
+    for (uint32_t i = 0; i < numDependencies && !reader.HasFailed(); ++i)
+    {
+        Dependency dependency;
+        dependency.mPath = reader.ReadString();
+        dependency.mContentHash = reader.Read<uint64_t>();
+        mDependencies.push_back(dependency);
+    }
+
+    const uint32_t numTokens = reader.Read<uint32_t>();
+    for (uint32_t i = 0; i < numTokens && !reader.HasFailed(); ++i)
+        mTokens.push_back(ReadToken(reader, identifierTable));
+
+    const uint32_t numDefinitions = reader.Read<uint32_t>();
+    for (uint32_t i = 0; i < numDefinitions && !reader.HasFailed(); ++i)
+    {
+        const IdentifierID name = identifierTable->Intern(reader.ReadString());
+        mDefinitions.push_back({ name, ReadMacro(reader, identifierTable) });
+    }
+
+    const uint32_t numPragmaOnceFiles = reader.Read<uint32_t>();
+    for (uint32_t i = 0; i < numPragmaOnceFiles && !reader.HasFailed(); ++i)
+        mPragmaOnceFiles.push_back(std::string(reader.ReadString()));
+
+    if (reader.HasFailed() || !reader.IsAtEnd())
+        return false;
+
+    outSourceFile = sourceFile;
+    return true;
+}
+
+bool PrecompiledHeader::IsUpToDate() const
+{
+    for (const Dependency& dependency : mDependencies)
+    {
+        SourceFile sourceFile;
+        if (!sourceFile.Open(dependency.mPath) || HashFNV1a(sourceFile.GetData(), sourceFile.GetSize()) != dependency.mContentHash)
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include "tokeniser.h"
+#include "macro.h"
+#include "source_file.h"
+
+/**
+* Precompiled header: the preprocessed tokens of a designated header, and the definitions after it.
+* Stored on disk (<header>.pch), and reused by later compilations while the header and the files it
+*  includes are unchanged. The tokens of a loaded PCH refer into the mapped PCH file.
+*/
+class PrecompiledHeader
+{
+public:
+    struct Dependency
+    {
+        std::string mPath;
+        uint64_t mContentHash;
+    };
+
+    std::vector<Dependency> mDependencies;
+    std::vector<Token> mTokens;
+    std::vector<std::pair<IdentifierID, Macro>> mDefinitions;
+    std::vector<std::string> mPragmaOnceFiles;
+
+    static std::string GetPCHPath(const std::string& headerPath);
+
+    bool Write(const std::string& path, const IdentifierTable* identifierTable) const;
+    bool Read(const std::string& path, IdentifierTable* identifierTable, std::shared_ptr<SourceFile>& outSourceFile);
+    // Are all dependencies unchanged?
+    bool IsUpToDate() const;
+};
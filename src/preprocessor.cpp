@@ -1,8 +1,10 @@
 #include "preprocessor.h"
-#include <fstream>
+#include "debug.h"
+#include "hash.h"
+#include <climits>
 
-Preprocessor::Preprocessor(TokenParser& inTokenParser, std::string fileDir)
-    : mTokenParser(inTokenParser), mFileDir(fileDir)
+Preprocessor::Preprocessor(TokenSource* tokenSource, std::string fileDir, CompilationUnit* compilationUnit, HeaderCache* headerCache)
+    : mTokenSource(tokenSource), mCompilationUnit(compilationUnit), mHeaderCache(headerCache), mFileDir(fileDir)
 {
 
 }
@@ -12,7 +14,7 @@ bool Preprocessor::IsCurrentScopeIgnored()
     return !mScopeStack.empty() && mScopeStack.top().mIgnoreContent;
 }
 
-PreprocessorDirective Preprocessor::GetPreprocessorDirective(const std::string& inToken)
+PreprocessorDirective Preprocessor::GetPreprocessorDirective(std::string_view inToken)
 {
     if (inToken == "#define")
     {
@@ -26,6 +28,14 @@ PreprocessorDirective Preprocessor::GetPreprocessorDirective(const std::string&
     {
         return PreprocessorDirective::Ifndef;
     }
+    else if (inToken == "#if")
+    {
+        return PreprocessorDirective::If;
+    }
+    else if (inToken == "#elif")
+    {
+        return PreprocessorDirective::Elif;
+    }
     else if (inToken == "#else")
     {
         return PreprocessorDirective::Else;
@@ -38,15 +48,314 @@ PreprocessorDirective Preprocessor::GetPreprocessorDirective(const std::string&
     {
         return PreprocessorDirective::Include;
     }
+    else if (inToken == "#pragma")
+    {
+        return PreprocessorDirective::Pragma;
+    }
     else
         return PreprocessorDirective::Invalid;
 }
 
-void Preprocessor::ProcessToken(Token inToken)
+namespace
+{
+    inline bool IsOperator(const Token& token, std::string_view op)
+    {
+        return token.mTokenType == ETokenType::Operator && token.mTokenString == op;
+    }
+
+    // Is there no whitespace between the tokens? (in the same source buffer)
+    inline bool AreTokensAdjacent(const Token& first, const Token& second)
+    {
+        return first.mTokenString.data() + first.mTokenString.size() == second.mTokenString.data();
+    }
+}
+
+Token Preprocessor::ReadToken()
+{
+    if (!mPushedBackTokens.empty())
+    {
+        Token token = mPushedBackTokens.back();
+        mPushedBackTokens.pop_back();
+        return token;
+    }
+
+    while (!mExpansionStack.empty())
+    {
+        MacroExpansion& expansion = mExpansionStack.back();
+        if (expansion.mTokenIndex < expansion.mTokens.size())
+            return expansion.mTokens[expansion.mTokenIndex++];
+        // End of the tokens that are being expanded on their own?
+        if (mExpansionStack.size() == mExpansionBarrier)
+        {
+            Token endToken;
+            endToken.mTokenType = ETokenType::EndOfFile;
+            return endToken;
+        }
+        mExpansionStack.pop_back(); // end of expansion (the macro is enabled again)
+    }
+
+    while (!mIncludeStack.empty())
+    {
+        Token token = mIncludeStack.back().mTokenSource->NextToken();
+        if (token.mTokenType != ETokenType::EndOfFile)
+            return token;
+        // End of precompiled header?
+        if (mRecordedHeader != nullptr && mIncludeStack.size() == 1)
+            WritePrecompiledHeader();
+        mIncludeStack.pop_back(); // end of included file
+    }
+    return mTokenSource->NextToken();
+}
+
+Token Preprocessor::ReadDirectiveToken()
+{
+    // Directives end with the file, so don't continue reading into the including file
+    TokenSource* tokenSource = mIncludeStack.empty() ? mTokenSource : mIncludeStack.back().mTokenSource.get();
+    return tokenSource->NextToken();
+}
+
+std::vector<Token> Preprocessor::ReadDirectiveLine()
+{
+    std::vector<Token> tokens;
+    Token token = ReadDirectiveToken();
+    while (token.mTokenType != ETokenType::NewLine && token.mTokenType != ETokenType::EndOfFile)
+    {
+        tokens.push_back(token);
+        token = ReadDirectiveToken();
+    }
+    return tokens;
+}
+
+bool Preprocessor::EvaluateCondition()
+{
+    const std::vector<Token> lineTokens = ReadDirectiveLine();
+
+    // Replace "defined X" and "defined(X)" before macros are expanded
+    std::vector<Token> tokens;
+    for (size_t i = 0; i < lineTokens.size(); i++)
+    {
+        const Token& token = lineTokens[i];
+        if (token.mTokenType != ETokenType::Identifier || token.mTokenString != "defined")
+        {
+            tokens.push_back(token);
+            continue;
+        }
+        const bool hasParens = i + 1 < lineTokens.size() && IsOperator(lineTokens[i + 1], "(");
+        const size_t nameIndex = hasParens ? i + 2 : i + 1;
+        if (nameIndex >= lineTokens.size() || lineTokens[nameIndex].mTokenType != ETokenType::Identifier
+            || (hasParens && (nameIndex + 1 >= lineTokens.size() || !IsOperator(lineTokens[nameIndex + 1], ")"))))
+        {
+            LOG_ERROR() << "Invalid use of 'defined' in #if";
+            return false;
+        }
+        Token definedToken = token;
+        definedToken.mTokenType = ETokenType::IntegerLiteral;
+        definedToken.mIntValue = mDefinitions.find(lineTokens[nameIndex].mIdentifierID) != mDefinitions.end() ? 1 : 0;
+        tokens.push_back(definedToken);
+        i = hasParens ? nameIndex + 1 : nameIndex;
+    }
+
+    tokens = ExpandTokens(tokens);
+    if (tokens.empty())
+    {
+        LOG_ERROR() << "#if with no expression";
+        return false;
+    }
+
+    size_t index = 0;
+    int value = 0;
+    if (!EvaluateExpression(tokens, index, INT_MAX, value))
+        return false;
+    if (index < tokens.size())
+    {
+        LOG_ERROR() << "Unexpected token in #if expression: " << tokens[index].mTokenString;
+        return false;
+    }
+    return value != 0;
+}
+
+bool Preprocessor::EvaluateExpression(const std::vector<Token>& tokens, size_t& inOutIndex, int precedence, int& outValue)
+{
+    if (!EvaluateAtom(tokens, inOutIndex, outValue))
+        return false;
+
+    while (inOutIndex < tokens.size() && tokens[inOutIndex].mTokenType == ETokenType::Operator)
+    {
+        const OperatorInfo* operatorInfo = FindBinaryOperator(tokens[inOutIndex].mOperator);
+        if (operatorInfo == nullptr || operatorInfo->mPrecedence >= precedence)
+            break;
+        inOutIndex++;
+
+        int rightValue = 0;
+        if (!EvaluateExpression(tokens, inOutIndex, operatorInfo->mPrecedence, rightValue))
+            return false;
+
+        switch (operatorInfo->mOperator)
+        {
+        case EOperator::Star:
+            outValue = outValue * rightValue;
+            break;
+        case EOperator::Slash:
+            if (rightValue == 0)
+            {
+                LOG_ERROR() << "Division by zero in #if expression";
+                return false;
+            }
+            outValue = outValue / rightValue;
+            break;
+        case EOperator::Plus:
+            outValue = outValue + rightValue;
+            break;
+        case EOperator::Minus:
+            outValue = outValue - rightValue;
+            break;
+        case EOperator::Greater:
+            outValue = outValue > rightValue;
+            break;
+        case EOperator::Less:
+            outValue = outValue < rightValue;
+            break;
+        case EOperator::GreaterEqual:
+            outValue = outValue >= rightValue;
+            break;
+        case EOperator::LessEqual:
+            outValue = outValue <= rightValue;
+            break;
+        case EOperator::Equal:
+            outValue = outValue == rightValue;
+            break;
+        case EOperator::NotEqual:
+            outValue = outValue != rightValue;
+            break;
+        case EOperator::LogicalAnd:
+            outValue = outValue && rightValue;
+            break;
+        case EOperator::LogicalXor:
+            outValue = (outValue != 0) != (rightValue != 0);
+            break;
+        case EOperator::LogicalOr:
+            outValue = outValue || rightValue;
+            break;
+        default:
+            LOG_ERROR() << "Operator not allowed in #if expression: " << GetOperatorString(operatorInfo->mOperator);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Preprocessor::EvaluateAtom(const std::vector<Token>& tokens, size_t& inOutIndex, int& outValue)
+{
+    if (inOutIndex >= tokens.size())
+    {
+        LOG_ERROR() << "Unexpected end of #if expression";
+        return false;
+    }
+
+    const Token& token = tokens[inOutIndex++];
+    switch (token.mTokenType)
+    {
+    case ETokenType::IntegerLiteral:
+    case ETokenType::BooleanLiteral:
+        outValue = token.mIntValue;
+        return true;
+    case ETokenType::Identifier:
+        // Not a macro
+        outValue = 0;
+        return true;
+    case ETokenType::Operator:
+    {
+        if (token.mTokenString == "(")
+        {
+            if (!EvaluateExpression(tokens, inOutIndex, INT_MAX, outValue))
+                return false;
+            if (inOutIndex >= tokens.size() || !IsOperator(tokens[inOutIndex], ")"))
+            {
+                LOG_ERROR() << "Missing ')' in #if expression";
+                return false;
+            }
+            inOutIndex++;
+            return true;
+        }
+
+        const OperatorInfo* operatorInfo = FindUnaryPrefixOperator(token.mOperator);
+        if (operatorInfo != nullptr && (operatorInfo->mOperator == EOperator::Not || operatorInfo->mOperator == EOperator::Plus || operatorInfo->mOperator == EOperator::Minus))
+        {
+            if (!EvaluateExpression(tokens, inOutIndex, operatorInfo->mPrecedence, outValue))
+                return false;
+            if (operatorInfo->mOperator == EOperator::Not)
+                outValue = !outValue;
+            else if (operatorInfo->mOperator == EOperator::Minus)
+                outValue = -outValue;
+            return true;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    LOG_ERROR() << "Unexpected token in #if expression: " << token.mTokenString;
+    return false;
+}
+
+void Preprocessor::IncludeFile(std::string_view includeName)
+{
+    if (mIncludeStack.size() >= MaxIncludeDepth)
+    {
+        LOG_ERROR() << "Max include depth exceeded when including: " << includeName;
+        return;
+    }
+
+    // Path is relative to the including file
+    const std::string& currentDir = mIncludeStack.empty() ? mFileDir : mIncludeStack.back().mFileDir;
+    const std::string includePath = currentDir.empty() ? std::string(includeName) : currentDir + "/" + std::string(includeName);
+    const std::string canonicalPath = HeaderCache::GetCanonicalPath(includePath);
+    if (mPragmaOnceFiles.find(canonicalPath) != mPragmaOnceFiles.end())
+        return;
+
+    if (canonicalPath == mPrecompiledHeaderPath && CanUsePrecompiledHeader())
+    {
+        if (LoadPrecompiledHeader())
+            return;
+        // Record it while preprocessing the header
+        mRecordedHeader = std::make_unique<PrecompiledHeader>();
+    }
+
+    std::shared_ptr<const CachedHeader> header = mHeaderCache->GetHeader(canonicalPath);
+    if (header == nullptr)
+    {
+        LOG_ERROR() << "Failed to open included file: " << includePath;
+        return;
+    }
+    if (header->mHasErrors)
+        mCompilationUnit->mHasErrors = true;
+
+    // Already included, and guarded by an include guard?
+    if (header->mGuardMacro != InvalidIdentifierID && mDefinitions.find(header->mGuardMacro) != mDefinitions.end())
+        return;
+
+    mCompilationUnit->RetainSourceFile(header->mSourceFile);
+
+    if (mRecordedHeader != nullptr)
+    {
+        const SourceFile* sourceFile = header->mSourceFile.get();
+        mRecordedHeader->mDependencies.push_back({ canonicalPath, HashFNV1a(sourceFile->GetData(), sourceFile->GetSize()) });
+    }
+
+    IncludedSource includedSource;
+    includedSource.mTokenSource = std::make_unique<CachedHeaderTokenSource>(header);
+    includedSource.mPath = canonicalPath;
+    const size_t lastSlashIndex = includePath.find_last_of("\\/");
+    if (lastSlashIndex != std::string::npos)
+        includedSource.mFileDir = includePath.substr(0, lastSlashIndex);
+    mIncludeStack.push_back(std::move(includedSource));
+}
+
+bool Preprocessor::ProcessToken(Token& inOutToken)
 {
     PreprocessorDirective directive = PreprocessorDirective::Invalid;
-    if (inToken.mTokenType == ETokenType::PreprocessorDirective)
-        directive = GetPreprocessorDirective(inToken.mTokenString);
+    if (inOutToken.mTokenType == ETokenType::PreprocessorDirective)
+        directive = GetPreprocessorDirective(inOutToken.mTokenString);
 
     // handle preprocessor directives
     if (directive != PreprocessorDirective::Invalid)
@@ -55,109 +364,461 @@ void Preprocessor::ProcessToken(Token inToken)
         {
         case PreprocessorDirective::Define:
         {
-            if (!IsCurrentScopeIgnored())
-            {
-                mTokenParser.Advance();
-                const Token defNameToken = mTokenParser.GetCurrentToken();
-                mTokenParser.Advance();
-                std::string defName = defNameToken.mTokenString;
-                const Token defValToken = mTokenParser.GetCurrentToken();
-                AddDefinition(defName, defValToken);
-            }
+            ReadDefinition();
             break;
         }
         case PreprocessorDirective::Ifdef:
         case PreprocessorDirective::Ifndef:
         {
-            mTokenParser.Advance();
-            std::string def = mTokenParser.GetCurrentToken().mTokenString;
+            const IdentifierID def = ReadDirectiveToken().mIdentifierID;
             PreprocessorScope scope;
             scope.mScopeType = PreprocessorScopeType::IfBody;
             scope.mIgnoreContent = IsCurrentScopeIgnored() || (mDefinitions.find(def) == mDefinitions.end()) == (directive == PreprocessorDirective::Ifdef);
+            scope.mBranchTaken = IsCurrentScopeIgnored() || !scope.mIgnoreContent;
             mScopeStack.push(scope);
             break;
         }
+        case PreprocessorDirective::If:
+        {
+            PreprocessorScope scope;
+            scope.mScopeType = PreprocessorScopeType::IfBody;
+            if (IsCurrentScopeIgnored())
+            {
+                ReadDirectiveLine();
+                scope.mIgnoreContent = true;
+                scope.mBranchTaken = true;
+            }
+            else
+            {
+                scope.mBranchTaken = EvaluateCondition();
+                scope.mIgnoreContent = !scope.mBranchTaken;
+            }
+            mScopeStack.push(scope);
+            break;
+        }
+        case PreprocessorDirective::Elif:
+        {
+            if (mScopeStack.empty() || mScopeStack.top().mScopeType == PreprocessorScopeType::ElseBody)
+            {
+                LOG_ERROR() << "#elif without #if";
+                ReadDirectiveLine();
+                break;
+            }
+            PreprocessorScope& scope = mScopeStack.top();
+            if (scope.mBranchTaken)
+            {
+                ReadDirectiveLine();
+                scope.mIgnoreContent = true;
+            }
+            else
+            {
+                scope.mBranchTaken = EvaluateCondition();
+                scope.mIgnoreContent = !scope.mBranchTaken;
+            }
+            break;
+        }
         case PreprocessorDirective::Else:
         {
-            PreprocessorScope scope = mScopeStack.top();
-            mScopeStack.pop();
+            if (mScopeStack.empty())
+            {
+                LOG_ERROR() << "#else without #if";
+                break;
+            }
+            PreprocessorScope& scope = mScopeStack.top();
             scope.mScopeType = PreprocessorScopeType::ElseBody;
-            scope.mIgnoreContent = IsCurrentScopeIgnored() || !scope.mIgnoreContent;
-            mScopeStack.push(scope);
+            scope.mIgnoreContent = scope.mBranchTaken;
+            scope.mBranchTaken = true;
             break;
         }
         case PreprocessorDirective::Endif:
         {
+            if (mScopeStack.empty())
+            {
+                LOG_ERROR() << "#endif without #if";
+                break;
+            }
             mScopeStack.pop();
             break;
         }
         case PreprocessorDirective::Include:
         {
-            mTokenParser.Advance();
-            // Read included file
-            std::string includePath = mTokenParser.GetCurrentToken().mTokenString;
-            includePath = includePath.substr(1, includePath.size() - 2);
-            includePath = mFileDir + "/" + includePath;
-            std::ifstream includedFile(includePath);
-            std::string fileContent((std::istreambuf_iterator<char>(includedFile)), std::istreambuf_iterator<char>());
-
-            // Parse included file
-            std::vector<Token> newTokens;
-            Tokeniser tokeniser(fileContent.c_str());
-            while (true)
+            const Token includeToken = ReadDirectiveToken();
+            if (IsCurrentScopeIgnored())
+                break;
+
+            // Read included file (its tokens are read next)
+            std::string_view includeName = includeToken.mTokenString;
+            IncludeFile(includeName.substr(1, includeName.size() - 2));
+            break;
+        }
+        case PreprocessorDirective::Pragma:
+        {
+            Token pragmaToken = ReadDirectiveToken();
+            if (pragmaToken.mTokenString == "once")
             {
-                Token token = tokeniser.ParseToken();
-                if (token.mTokenString != "")
-                {
-                    newTokens.push_back(token);
-                }
-                else if (token.mTokenType == ETokenType::EndOfFile)
-                {
-                    break;
-                }
+                if (!IsCurrentScopeIgnored() && !mIncludeStack.empty())
+                    mPragmaOnceFiles.insert(mIncludeStack.back().mPath);
+                break;
             }
-
-            // Copy new tokens
-            std::vector<Token>& tokens = mTokenParser.GetTokens();
-            size_t numTokens = tokens.size();
-            size_t nextTokenIndex = mTokenParser.GetCurrentTokenIndex() + 1;
-            tokens.insert(tokens.begin() + nextTokenIndex, newTokens.begin(), newTokens.end());
+            // Unknown pragma: ignore the rest of the line
+            while (pragmaToken.mTokenType != ETokenType::NewLine && pragmaToken.mTokenType != ETokenType::EndOfFile)
+                pragmaToken = ReadDirectiveToken();
             break;
         }
         }
+        return false;
     }
     else if (!IsCurrentScopeIgnored())
     {
-        // replace preprocessor definition
-        if (inToken.mTokenType == ETokenType::Identifier)
+        // expand macro (the replacement tokens are read next)
+        if (ExpandMacro(inOutToken))
+            return false;
+        // output preprocessed token
+        return inOutToken.mTokenType != ETokenType::NewLine;
+    }
+    return false;
+}
+
+void Preprocessor::ReadDefinition()
+{
+    const Token nameToken = ReadDirectiveToken();
+    Macro macro;
+    Token token = ReadDirectiveToken();
+
+    // Function-like macro, if the parameter list follows the name directly
+    if (IsOperator(token, "(") && AreTokensAdjacent(nameToken, token))
+    {
+        macro.mFunctionLike = true;
+        token = ReadDirectiveToken();
+        while (!IsOperator(token, ")"))
         {
-            auto defIter = mDefinitions.find(inToken.mTokenString);
-            if (defIter != mDefinitions.end())
+            if (token.mTokenType == ETokenType::Identifier)
+            {
+                macro.mParameters.push_back(token.mIdentifierID);
+            }
+            else if (!IsOperator(token, ","))
             {
-                inToken = defIter->second;
+                LOG_ERROR() << "Invalid parameter list in definition of macro: " << nameToken.mTokenString;
+                while (token.mTokenType != ETokenType::NewLine && token.mTokenType != ETokenType::EndOfFile)
+                    token = ReadDirectiveToken();
+                return;
             }
+            token = ReadDirectiveToken();
         }
-        // push preprocessed token
-        if (inToken.mTokenType != ETokenType::NewLine)
-            mPreprocessedTokens.push_back(inToken);
+        token = ReadDirectiveToken();
+    }
+
+    // The body is the rest of the line
+    while (token.mTokenType != ETokenType::NewLine && token.mTokenType != ETokenType::EndOfFile)
+    {
+        macro.mBody.push_back(token);
+        token = ReadDirectiveToken();
+    }
+
+    if (!IsCurrentScopeIgnored())
+        AddDefinition(nameToken.mIdentifierID, std::move(macro));
+}
+
+void Preprocessor::AddDefinition(IdentifierID name, Macro macro)
+{
+    mDefinitions.insert_or_assign(name, std::move(macro));
+}
+
+bool Preprocessor::IsMacroDisabled(IdentifierID name)
+{
+    for (const MacroExpansion& expansion : mExpansionStack)
+    {
+        if (expansion.mMacro == name)
+            return true;
+    }
+    return false;
+}
+
+bool Preprocessor::ExpandMacro(Token& inOutToken)
+{
+    if (inOutToken.mTokenType != ETokenType::Identifier || inOutToken.mNoExpand)
+        return false;
+
+    auto defIter = mDefinitions.find(inOutToken.mIdentifierID);
+    if (defIter == mDefinitions.end())
+        return false;
+
+    if (IsMacroDisabled(inOutToken.mIdentifierID))
+    {
+        // Never expanded, even if the token is rescanned later on (as part of a macro argument)
+        inOutToken.mNoExpand = true;
+        return false;
+    }
+
+    const Macro& macro = defIter->second;
+    std::vector<std::vector<Token>> arguments;
+    if (macro.mFunctionLike)
+    {
+        // Not an invocation, unless followed by '('
+        Token nextToken = ReadToken();
+        while (nextToken.mTokenType == ETokenType::NewLine)
+            nextToken = ReadToken();
+        if (!IsOperator(nextToken, "("))
+        {
+            if (nextToken.mTokenType != ETokenType::EndOfFile)
+                mPushedBackTokens.push_back(nextToken);
+            return false;
+        }
+
+        if (!ReadMacroArguments(arguments))
+        {
+            LOG_ERROR() << "Unterminated invocation of macro: " << inOutToken.mTokenString;
+            return true;
+        }
+        // "()" is one empty argument
+        if (macro.mParameters.empty() && arguments.size() == 1 && arguments[0].empty())
+            arguments.clear();
+        if (arguments.size() != macro.mParameters.size())
+        {
+            LOG_ERROR() << "Macro " << inOutToken.mTokenString << " takes " << macro.mParameters.size() << " arguments, but " << arguments.size() << " were given";
+            return true;
+        }
+    }
+
+    MacroExpansion expansion;
+    expansion.mTokens = SubstituteMacro(macro, arguments);
+    expansion.mMacro = inOutToken.mIdentifierID;
+    mExpansionStack.push_back(std::move(expansion));
+    return true;
+}
+
+bool Preprocessor::ReadMacroArguments(std::vector<std::vector<Token>>& outArguments)
+{
+    outArguments.emplace_back();
+    int parenDepth = 1;
+    while (true)
+    {
+        const Token token = ReadToken();
+        if (token.mTokenType == ETokenType::EndOfFile)
+            return false;
+        if (token.mTokenType == ETokenType::NewLine)
+            continue;
+
+        if (IsOperator(token, "("))
+        {
+            parenDepth++;
+        }
+        else if (IsOperator(token, ")"))
+        {
+            if (--parenDepth == 0)
+                return true;
+        }
+        else if (IsOperator(token, ",") && parenDepth == 1)
+        {
+            outArguments.emplace_back();
+            continue;
+        }
+        outArguments.back().push_back(token);
+    }
+}
+
+std::vector<Token> Preprocessor::ExpandTokens(const std::vector<Token>& tokens)
+{
+    // The tokens are expanded on their own (a macro argument or #if expression), so reading stops at the end of them
+    MacroExpansion tokensExpansion;
+    tokensExpansion.mTokens = tokens;
+    mExpansionStack.push_back(std::move(tokensExpansion));
+    const size_t prevExpansionBarrier = mExpansionBarrier;
+    mExpansionBarrier = mExpansionStack.size();
+
+    std::vector<Token> expandedTokens;
+    while (true)
+    {
+        Token token = ReadToken();
+        if (token.mTokenType == ETokenType::EndOfFile)
+            break;
+        if (!ExpandMacro(token))
+            expandedTokens.push_back(token);
     }
+
+    mExpansionStack.pop_back();
+    mExpansionBarrier = prevExpansionBarrier;
+    return expandedTokens;
 }
 
-void Preprocessor::AddDefinition(std::string name, Token token)
+std::vector<Token> Preprocessor::SubstituteMacro(const Macro& macro, const std::vector<std::vector<Token>>& arguments)
 {
-    mDefinitions.emplace(name, token);
+    const std::vector<Token>& body = macro.mBody;
+    std::vector<Token> outTokens;
+    outTokens.reserve(body.size());
+
+    // Arguments are expanded once, when first used
+    std::vector<std::vector<Token>> expandedArguments(arguments.size());
+    std::vector<bool> isArgumentExpanded(arguments.size(), false);
+
+    bool pasteNext = false;
+    auto appendTokens = [&](const Token* begin, const Token* end)
+    {
+        if (begin != end && pasteNext)
+        {
+            outTokens.back() = PasteTokens(outTokens.back(), *begin);
+            begin++;
+        }
+        outTokens.insert(outTokens.end(), begin, end);
+        pasteNext = false;
+    };
+
+    for (size_t i = 0; i < body.size(); i++)
+    {
+        const Token& bodyToken = body[i];
+        if (IsOperator(bodyToken, "##"))
+        {
+            pasteNext = !outTokens.empty();
+            continue;
+        }
+
+        // Stringified parameter (#param or # param)
+        if (macro.mFunctionLike && bodyToken.mTokenType == ETokenType::PreprocessorDirective)
+        {
+            int parameterIndex = -1;
+            if (bodyToken.mTokenString.size() > 1)
+            {
+                parameterIndex = macro.GetParameterIndex(mCompilationUnit->mIdentifierTable->Find(bodyToken.mTokenString.substr(1)));
+            }
+            else if (i + 1 < body.size() && body[i + 1].mTokenType == ETokenType::Identifier)
+            {
+                parameterIndex = macro.GetParameterIndex(body[i + 1].mIdentifierID);
+                if (parameterIndex != -1)
+                    i++;
+            }
+            if (parameterIndex != -1)
+            {
+                const Token stringToken = StringifyTokens(arguments[parameterIndex], bodyToken.mLineNumber);
+                appendTokens(&stringToken, &stringToken + 1);
+                continue;
+            }
+        }
+
+        const int parameterIndex = bodyToken.mTokenType == ETokenType::Identifier ? macro.GetParameterIndex(bodyToken.mIdentifierID) : -1;
+        if (parameterIndex == -1)
+        {
+            appendTokens(&bodyToken, &bodyToken + 1);
+            continue;
+        }
+
+        // Operands of ## are not expanded
+        const bool isPasteOperand = pasteNext || (i + 1 < body.size() && IsOperator(body[i + 1], "##"));
+        if (!isPasteOperand && !isArgumentExpanded[parameterIndex])
+        {
+            expandedArguments[parameterIndex] = ExpandTokens(arguments[parameterIndex]);
+            isArgumentExpanded[parameterIndex] = true;
+        }
+        const std::vector<Token>& argument = isPasteOperand ? arguments[parameterIndex] : expandedArguments[parameterIndex];
+        appendTokens(argument.data(), argument.data() + argument.size());
+    }
+    return outTokens;
 }
 
-void Preprocessor::Preprocess()
+Token Preprocessor::StringifyTokens(const std::vector<Token>& tokens, int lineNumber)
 {
-    while (mTokenParser.HasMoreTokens())
+    std::string text = "\"";
+    for (size_t i = 0; i < tokens.size(); i++)
     {
-        Token token = mTokenParser.GetCurrentToken();
+        const Token& token = tokens[i];
+        if (i > 0 && !AreTokensAdjacent(tokens[i - 1], token))
+            text += ' ';
+        for (const char c : token.mTokenString)
+        {
+            if (token.mTokenType == ETokenType::StringLiteral && (c == '"' || c == '\\'))
+                text += '\\';
+            text += c;
+        }
+    }
+    text += '"';
+
+    Token stringToken;
+    stringToken.mTokenType = ETokenType::StringLiteral;
+    stringToken.mTokenString = mCompilationUnit->AddGeneratedText(text);
+    stringToken.mLineNumber = lineNumber;
+    return stringToken;
+}
+
+Token Preprocessor::PasteTokens(const Token& left, const Token& right)
+{
+    const std::string_view text = mCompilationUnit->AddGeneratedText(std::string(left.mTokenString) + std::string(right.mTokenString));
+    Tokeniser tokeniser(text.data(), text.size(), mCompilationUnit->mIdentifierTable);
+    Token pastedToken = tokeniser.ParseToken();
+    if (pastedToken.mTokenType == ETokenType::EndOfFile || tokeniser.ParseToken().mTokenType != ETokenType::EndOfFile)
+        LOG_ERROR() << "Pasting " << left.mTokenString << " and " << right.mTokenString << " does not give a valid token";
+    pastedToken.mLineNumber = left.mLineNumber;
+    return pastedToken;
+}
+
+bool Preprocessor::CanUsePrecompiledHeader()
+{
+    // The PCH only represents the state after the header, when nothing came before it
+    return mIncludeStack.empty() && !mHasOutput && mDefinitions.empty() && mScopeStack.empty() && mPragmaOnceFiles.empty();
+}
+
+bool Preprocessor::LoadPrecompiledHeader()
+{
+    std::unique_ptr<PrecompiledHeader> pch = std::make_unique<PrecompiledHeader>();
+    std::shared_ptr<SourceFile> pchFile;
+    if (!pch->Read(PrecompiledHeader::GetPCHPath(mPrecompiledHeaderPath), mCompilationUnit->mIdentifierTable, pchFile) || !pch->IsUpToDate())
+        return false;
+
+    // The loaded tokens refer to the PCH file
+    mCompilationUnit->RetainSourceFile(pchFile);
+
+    for (const auto& definition : pch->mDefinitions)
+        mDefinitions[definition.first] = definition.second;
+    for (const std::string& pragmaOnceFile : pch->mPragmaOnceFiles)
+        mPragmaOnceFiles.insert(pragmaOnceFile);
+
+    LOG_INFO() << "Using precompiled header: " << PrecompiledHeader::GetPCHPath(mPrecompiledHeaderPath);
+
+    mPrecompiledHeader = std::move(pch);
+    mPrecompiledTokenIndex = 0;
+    return true;
+}
+
+void Preprocessor::WritePrecompiledHeader()
+{
+    for (const auto& definition : mDefinitions)
+        mRecordedHeader->mDefinitions.push_back(definition);
+    for (const std::string& pragmaOnceFile : mPragmaOnceFiles)
+        mRecordedHeader->mPragmaOnceFiles.push_back(pragmaOnceFile);
+
+    const std::string pchPath = PrecompiledHeader::GetPCHPath(mPrecompiledHeaderPath);
+    if (mRecordedHeader->Write(pchPath, mCompilationUnit->mIdentifierTable))
+        LOG_INFO() << "Wrote precompiled header: " << pchPath;
+    else
+        LOG_WARNING() << "Failed to write precompiled header: " << pchPath;
+
+    mRecordedHeader.reset();
+}
+
+void Preprocessor::SetPrecompiledHeader(const std::string& headerPath)
+{
+    mPrecompiledHeaderPath = HeaderCache::GetCanonicalPath(headerPath);
+}
 
-        ProcessToken(token);
+Token Preprocessor::NextToken()
+{
+    while (true)
+    {
+        // Tokens of a precompiled header are already preprocessed
+        if (mPrecompiledHeader != nullptr)
+        {
+            if (mPrecompiledTokenIndex < mPrecompiledHeader->mTokens.size())
+                return mPrecompiledHeader->mTokens[mPrecompiledTokenIndex++];
+            mPrecompiledHeader.reset();
+        }
 
-        mTokenParser.Advance();
+        Token token = ReadToken();
+        if (token.mTokenType == ETokenType::EndOfFile)
+            return token;
+        if (ProcessToken(token))
+        {
+            if (mRecordedHeader != nullptr)
+                mRecordedHeader->mTokens.push_back(token);
+            mHasOutput = true;
+            return token;
+        }
     }
-    mTokenParser.SetTokens(mPreprocessedTokens);
-    mTokenParser.ResetPosition();
 }
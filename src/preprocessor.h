@@ -1,7 +1,14 @@
 #pragma once
 
 #include <string>
+#include <memory>
+#include <unordered_set>
 #include "tokeniser.h"
+#include "compilation_unit.h"
+#include "header_cache.h"
+#include "macro.h"
+#include "operator.h"
+#include "precompiled_header.h"
 
 enum class PreprocessorScopeType
 {
@@ -13,6 +20,7 @@ struct PreprocessorScope
 {
     PreprocessorScopeType mScopeType;
     bool mIgnoreContent = false;
+    bool mBranchTaken = false; // has one of the #if/#elif/#else branches been selected?
 };
 
 enum class PreprocessorDirective
@@ -20,28 +28,94 @@ enum class PreprocessorDirective
     Define,
     Ifdef,
     Ifndef,
+    If,
+    Elif,
     Else,
     Endif,
     Include,
+    Pragma,
     Invalid
 };
 
-class Preprocessor
+/**
+* A file that is currently being included.
+*/
+struct IncludedSource
+{
+    std::unique_ptr<TokenSource> mTokenSource;
+    std::string mPath;
+    std::string mFileDir;
+};
+
+/**
+* The replacement tokens of a macro invocation, read before anything that follows the invocation.
+* The macro is disabled while its expansion is being read, so recursive invocations are left unexpanded.
+*/
+struct MacroExpansion
+{
+    std::vector<Token> mTokens;
+    size_t mTokenIndex = 0;
+    IdentifierID mMacro = InvalidIdentifierID;
+};
+
+/**
+* Pulls tokens from the tokeniser, and returns the preprocessed tokens one by one.
+* Included files are read through a stack of token sources, so they are consumed in place.
+* Macro expansions are read through a stack as well, so expanded tokens are rescanned once, as they are read.
+*/
+class Preprocessor : public TokenSource
 {
 private:
-    TokenParser& mTokenParser;
+    static const size_t MaxIncludeDepth = 200;
+
+    TokenSource* mTokenSource;
+    CompilationUnit* mCompilationUnit;
+    HeaderCache* mHeaderCache;
     std::string mFileDir;
     std::stack<PreprocessorScope> mScopeStack;
-    std::unordered_map<std::string, Token> mDefinitions;
-    std::vector<Token> mPreprocessedTokens;
+    std::unordered_map<IdentifierID, Macro> mDefinitions;
+    std::vector<MacroExpansion> mExpansionStack; // top = innermost expansion
+    size_t mExpansionBarrier = 0; // expansions at or below this depth aren't read (while expanding a macro argument)
+    std::vector<Token> mPushedBackTokens;
+    std::vector<IncludedSource> mIncludeStack; // top = innermost included file
+    std::unordered_set<std::string> mPragmaOnceFiles;
+    bool mHasOutput = false;
 
-    PreprocessorDirective GetPreprocessorDirective(const std::string& inToken);
-    void ProcessToken(Token inToken);
+    // Precompiled header
+    std::string mPrecompiledHeaderPath; // canonical path of the designated header
+    std::unique_ptr<PrecompiledHeader> mPrecompiledHeader; // loaded PCH, until its tokens have been read
+    size_t mPrecompiledTokenIndex = 0;
+    std::unique_ptr<PrecompiledHeader> mRecordedHeader; // PCH being recorded while the header is preprocessed
+
+    PreprocessorDirective GetPreprocessorDirective(std::string_view inToken);
+    Token ReadToken();
+    Token ReadDirectiveToken();
+    std::vector<Token> ReadDirectiveLine();
+    void ReadDefinition();
+    bool IsMacroDisabled(IdentifierID name);
+    bool ExpandMacro(Token& inOutToken);
+    bool ReadMacroArguments(std::vector<std::vector<Token>>& outArguments);
+    std::vector<Token> ExpandTokens(const std::vector<Token>& tokens);
+    std::vector<Token> SubstituteMacro(const Macro& macro, const std::vector<std::vector<Token>>& arguments);
+    Token StringifyTokens(const std::vector<Token>& tokens, int lineNumber);
+    Token PasteTokens(const Token& left, const Token& right);
+    bool EvaluateCondition();
+    bool EvaluateExpression(const std::vector<Token>& tokens, size_t& inOutIndex, int precedence, int& outValue);
+    bool EvaluateAtom(const std::vector<Token>& tokens, size_t& inOutIndex, int& outValue);
+    void IncludeFile(std::string_view includeName);
+    bool CanUsePrecompiledHeader();
+    bool LoadPrecompiledHeader();
+    void WritePrecompiledHeader();
+    bool ProcessToken(Token& inOutToken);
     bool IsCurrentScopeIgnored();
 
 public:
-    Preprocessor(TokenParser& inTokenParser, std::string fileDir);
+    Preprocessor(TokenSource* tokenSource, std::string fileDir, CompilationUnit* compilationUnit, HeaderCache* headerCache);
+
+    void AddDefinition(IdentifierID name, Macro macro);
+    // The state after this header is stored in (and read from) a precompiled header file.
+    // Only used when the header is included before anything else in the source.
+    void SetPrecompiledHeader(const std::string& headerPath);
 
-    void AddDefinition(std::string name, Token token);
-    void Preprocess();
+    virtual Token NextToken() override;
 };
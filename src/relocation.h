@@ -2,9 +2,28 @@
 
 #include <vector>
 #include <string>
+#include <stdint.h>
+
+/**
+* A block of RAM used by a unit (a variable, parameter or temporary).
+* The code generator gives it a unit-local address, and the linker places it in RAM.
+*/
+struct DataSymbol
+{
+    uint16_t mLocalAddress;
+    uint16_t mSize;
+    uint16_t mAlignment = 1;
+    bool mZeroPage = false; // accessed with 1-byte operands, so it must be placed in $0000-$00FF
+    uint32_t mWeight = 0; // static access count, weighted by loop depth. The hottest data gets zero page first.
+    uint16_t mAddress = 0; // set by the linker
+};
 
 struct RelocationText
 {
     std::vector<std::pair<size_t, std::string>> mSymAddrRefs; // TODO: refactor
     std::vector<size_t> mRelativeAddresses;
+    std::vector<DataSymbol> mDataSymbols; // ordered by local address
+    std::vector<size_t> mDataAddresses; // operands holding a unit-local RAM address
+    std::vector<std::pair<size_t, uint16_t>> mZeroPageDataAddresses; // 1-byte operands and the unit-local RAM address they refer to
+    std::vector<std::pair<size_t, uint16_t>> mBranchTargets; // branch instructions and the unit-local code address they go to
 };
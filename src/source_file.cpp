@@ -0,0 +1,59 @@
+#include "source_file.h"
+#include <fstream>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+SourceFile::~SourceFile()
+{
+#ifndef _WIN32
+    if (mMapping != nullptr)
+        munmap(mMapping, mSize);
+#endif
+}
+
+bool SourceFile::Open(const std::string& path)
+{
+    mPath = path;
+
+#ifndef _WIN32
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    mSize = static_cast<size_t>(fileStat.st_size);
+    if (mSize > 0)
+    {
+        void* mapping = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED)
+        {
+            mMapping = mapping;
+            mData = static_cast<const char*>(mapping);
+        }
+    }
+    close(fd);
+
+    if (mMapping != nullptr || mSize == 0)
+        return true;
+#endif
+
+    // Fall back to reading the file into memory
+    std::ifstream fileStream(path, std::ios::in | std::ios::binary);
+    if (!fileStream)
+        return false;
+    mBuffer.assign((std::istreambuf_iterator<char>(fileStream)), std::istreambuf_iterator<char>());
+    mData = mBuffer.data();
+    mSize = mBuffer.size();
+    return true;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+
+/**
+* A read-only source file, memory mapped where the platform supports it.
+* The Tokeniser reads the mapped bytes directly, so tokens refer into the mapping.
+* The file must therefore stay open for as long as its tokens are in use.
+*/
+class SourceFile
+{
+private:
+    std::string mPath;
+    const char* mData = "";
+    size_t mSize = 0;
+    void* mMapping = nullptr;
+    std::string mBuffer; // used when the file can't be mapped
+
+public:
+    SourceFile() {}
+    SourceFile(const SourceFile&) = delete;
+    SourceFile& operator=(const SourceFile&) = delete;
+    ~SourceFile();
+
+    bool Open(const std::string& path);
+
+    const std::string& GetPath() const { return mPath; }
+    const char* GetData() const { return mData; }
+    size_t GetSize() const { return mSize; }
+};
@@ -0,0 +1,45 @@
+#include "symbol_table.h"
+
+void ScopedSymbolTable::PushScope()
+{
+    mScopeStarts.push_back(mDeclaredSymbols.size());
+}
+
+void ScopedSymbolTable::PopScope()
+{
+    // Unshadow in reverse order, in case a name was declared twice in the scope
+    const size_t scopeStart = mScopeStarts.back();
+    mScopeStarts.pop_back();
+    while (mDeclaredSymbols.size() > scopeStart)
+    {
+        Symbol* symbol = mDeclaredSymbols.back();
+        mDeclaredSymbols.pop_back();
+        if (symbol->mShadowed != nullptr)
+            mVisibleSymbols[symbol->mNameID] = symbol->mShadowed;
+        else
+            mVisibleSymbols.erase(symbol->mNameID);
+        symbol->mShadowed = nullptr;
+    }
+}
+
+void ScopedSymbolTable::AddSymbol(Symbol* symbol)
+{
+    Symbol*& visibleSymbol = mVisibleSymbols[symbol->mNameID];
+    symbol->mShadowed = visibleSymbol;
+    visibleSymbol = symbol;
+    mDeclaredSymbols.push_back(symbol);
+}
+
+Symbol* ScopedSymbolTable::Find(IdentifierID name, ESymbolType symbolType) const
+{
+    auto symbolIter = mVisibleSymbols.find(name);
+    if (symbolIter == mVisibleSymbols.end())
+        return nullptr;
+
+    for (Symbol* symbol = symbolIter->second; symbol != nullptr; symbol = symbol->mShadowed)
+    {
+        if ((symbol->mSymbolType & symbolType) != ESymbolType::None)
+            return symbol;
+    }
+    return nullptr;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include "compilation_unit.h"
+
+/**
+* The symbols visible from the current scope, indexed by interned name.
+* A name maps to its innermost symbol, and the symbols it shadows are chained through Symbol::mShadowed.
+* Lookups are O(1) regardless of the number of symbols and the scope depth.
+* Entering a scope is O(1), and leaving it is O(number of symbols declared in it).
+*/
+class ScopedSymbolTable
+{
+private:
+    std::unordered_map<IdentifierID, Symbol*> mVisibleSymbols;
+    std::vector<Symbol*> mDeclaredSymbols; // in declaration order, innermost scope last
+    std::vector<size_t> mScopeStarts; // index into mDeclaredSymbols of each open scope's first symbol
+
+public:
+    void PushScope();
+    void PopScope();
+    void AddSymbol(Symbol* symbol);
+    // Returns the innermost symbol with this name and one of the given types
+    Symbol* Find(IdentifierID name, ESymbolType symbolType) const;
+};
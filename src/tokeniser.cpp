@@ -3,228 +3,362 @@
 #include <fstream>
 #include <string>
 #include <numeric>
+#include <cstring>
+#include <charconv>
+#include <cassert>
 #include "debug.h"
+#include "hash.h"
 
-Tokeniser::Tokeniser(const char* inSourceText)
+namespace
 {
-    mSourceText = inSourceText;
-    mSourceStringPos = mSourceText.c_str();
+    enum ECharClass : uint8_t
+    {
+        CharClassNone = 0,
+        CharClassWhitespace = 1,
+        CharClassNewLine = 2,
+        CharClassDigit = 4,
+        CharClassPunctuator = 8,
+        CharClassQuote = 16,
+        CharClassEnd = 32,
+        CharClassHash = 64
+    };
+
+    // Characters that may follow the first character of a double punctuator
+    enum EDoublePunctuatorSecond : uint8_t
+    {
+        SecondEquals = 1,   // ==, >=, <=, !=, +=, *=, /=, &=, |=
+        SecondAmpersand = 2,// &&
+        SecondPipe = 4,     // ||
+        SecondGreater = 8   // ->
+    };
+
+    struct CharTables
+    {
+        uint8_t mCharClass[256];
+        // DFA for double punctuators: state after the first character (accepted second characters),
+        //  and the transition bit of the second character.
+        uint8_t mDoubleFirst[256];
+        uint8_t mDoubleSecond[256];
+        // Operator of a single punctuator, and of a punctuator followed by '='
+        EOperator mSingleOperator[256];
+        EOperator mEqualsOperator[256];
+    };
+
+    constexpr CharTables BuildCharTables()
+    {
+        CharTables tables{};
+
+        tables.mCharClass[static_cast<uint8_t>('\0')] = CharClassEnd;
+        tables.mCharClass[static_cast<uint8_t>(' ')] = CharClassWhitespace;
+        tables.mCharClass[static_cast<uint8_t>('\t')] = CharClassWhitespace;
+        tables.mCharClass[static_cast<uint8_t>('\r')] = CharClassWhitespace;
+        tables.mCharClass[static_cast<uint8_t>('\n')] = CharClassNewLine;
+        tables.mCharClass[static_cast<uint8_t>('"')] = CharClassQuote;
+        tables.mCharClass[static_cast<uint8_t>('#')] = CharClassHash;
+        for (char c = '0'; c <= '9'; c++)
+            tables.mCharClass[static_cast<uint8_t>(c)] = CharClassDigit;
+
+        const char punctuators[] = { '[', ']', '(' , ')' , '{' , '}' , ',' , '.' , ';' , ':' , '<', '>', '=', '!', '+', '-', '*', '/', '&', '|', '?' };
+        for (const char c : punctuators)
+            tables.mCharClass[static_cast<uint8_t>(c)] = CharClassPunctuator;
+
+        const char equalsFirst[] = { '=', '>', '<', '!', '+', '*', '/', '&', '|' };
+        for (const char c : equalsFirst)
+            tables.mDoubleFirst[static_cast<uint8_t>(c)] |= SecondEquals;
+        tables.mDoubleFirst[static_cast<uint8_t>('&')] |= SecondAmpersand;
+        tables.mDoubleFirst[static_cast<uint8_t>('|')] |= SecondPipe;
+        tables.mDoubleFirst[static_cast<uint8_t>('-')] |= SecondGreater;
+
+        tables.mDoubleSecond[static_cast<uint8_t>('=')] = SecondEquals;
+        tables.mDoubleSecond[static_cast<uint8_t>('&')] = SecondAmpersand;
+        tables.mDoubleSecond[static_cast<uint8_t>('|')] = SecondPipe;
+        tables.mDoubleSecond[static_cast<uint8_t>('>')] = SecondGreater;
+
+        tables.mSingleOperator[static_cast<uint8_t>('!')] = EOperator::Not;
+        tables.mSingleOperator[static_cast<uint8_t>('+')] = EOperator::Plus;
+        tables.mSingleOperator[static_cast<uint8_t>('-')] = EOperator::Minus;
+        tables.mSingleOperator[static_cast<uint8_t>('*')] = EOperator::Star;
+        tables.mSingleOperator[static_cast<uint8_t>('/')] = EOperator::Slash;
+        tables.mSingleOperator[static_cast<uint8_t>('>')] = EOperator::Greater;
+        tables.mSingleOperator[static_cast<uint8_t>('<')] = EOperator::Less;
+        tables.mSingleOperator[static_cast<uint8_t>('=')] = EOperator::Assign;
+
+        tables.mEqualsOperator[static_cast<uint8_t>('=')] = EOperator::Equal;
+        tables.mEqualsOperator[static_cast<uint8_t>('>')] = EOperator::GreaterEqual;
+        tables.mEqualsOperator[static_cast<uint8_t>('<')] = EOperator::LessEqual;
+        tables.mEqualsOperator[static_cast<uint8_t>('!')] = EOperator::NotEqual;
+        tables.mEqualsOperator[static_cast<uint8_t>('+')] = EOperator::AddAssign;
+
+        return tables;
+    }
+
+    constexpr CharTables kCharTables = BuildCharTables();
+
+    inline uint8_t GetCharClass(const char c)
+    {
+        return kCharTables.mCharClass[static_cast<uint8_t>(c)];
+    }
+
+    // Token pasting operator (##), used in macro bodies
+    inline bool IsTokenPaste(const char* pos, const char* end)
+    {
+        return pos + 1 < end && pos[0] == '#' && pos[1] == '#';
+    }
+
+    inline bool IsDoublePunctuator(const char first, const char second)
+    {
+        return (kCharTables.mDoubleFirst[static_cast<uint8_t>(first)] & kCharTables.mDoubleSecond[static_cast<uint8_t>(second)]) != 0;
+    }
+
+    inline EOperator GetDoubleOperator(const char first, const char second)
+    {
+        switch (second)
+        {
+        case '=':
+            return kCharTables.mEqualsOperator[static_cast<uint8_t>(first)];
+        case '&':
+            return EOperator::LogicalAnd;
+        case '|':
+            return EOperator::LogicalOr;
+        case '>':
+            return EOperator::Arrow;
+        default:
+            return EOperator::None;
+        }
+    }
 }
 
-bool Tokeniser::isOperator(const char* inToken)
+Token TokenListSource::NextToken()
 {
-    return (mPunctuators.find(*inToken) != mPunctuators.end() || mDoublePunctuators.find(inToken) != mDoublePunctuators.end());
+    if (mTokenIndex < mTokens.size())
+        return mTokens[mTokenIndex++];
+
+    Token eofToken;
+    eofToken.mTokenType = ETokenType::EndOfFile;
+    return eofToken;
+}
+
+Tokeniser::Tokeniser(const char* inSourceText, size_t inLength, IdentifierTable* identifierTable)
+{
+    mIdentifierTable = identifierTable;
+    mSourceStringPos = inSourceText;
+    mSourceEnd = inSourceText + inLength;
+}
+
+IdentifierID Tokeniser::InternIdentifier(std::string_view name)
+{
+    if (mIdentifierCache.empty())
+        mIdentifierCache.resize(IdentifierCacheSize);
+
+    IdentifierCacheEntry& entry = mIdentifierCache[HashFNV1a(name.data(), name.size()) & (IdentifierCacheSize - 1)];
+    if (entry.mID == InvalidIdentifierID || entry.mName != name)
+    {
+        entry.mID = mIdentifierTable->Intern(name);
+        entry.mName = mIdentifierTable->GetName(entry.mID);
+    }
+    return entry.mID;
 }
 
 Token Tokeniser::ParseToken()
 {
     Token outToken;
+    const char* pos = mSourceStringPos;
+    const char* const end = mSourceEnd;
 
-    // Remove whitespaces and tabs from beginning
-    while (*mSourceStringPos == ' ' || *mSourceStringPos == '\t')
+    // Remove whitespaces, tabs and comments from beginning
+    while (true)
     {
-        if(*mSourceStringPos == '\n')
-            mLineNumber++; // count linebreaks
-        mSourceStringPos++;
-    }
+        while (pos < end && (GetCharClass(*pos) & CharClassWhitespace))
+            pos++;
 
-    if (*mSourceStringPos == '\n')
+        if (pos + 1 < end && pos[0] == '\\' && (pos[1] == '\n' || (pos[1] == '\r' && pos + 2 < end && pos[2] == '\n')))
         {
-            mSourceStringPos++;
-            mLineNumber++; // count linebreaks
-            outToken.mTokenType = ETokenType::NewLine;
-            outToken.mTokenString = "\n";
-            return outToken;
+            // Line continuation
+            pos += pos[1] == '\n' ? 2 : 3;
+            mLineNumber++;
         }
+        else if (pos + 1 < end && pos[0] == '/' && pos[1] == '/')
+        {
+            // Skip until end of line (the line break becomes a NewLine token)
+            pos += 2;
+            while (pos < end && !(GetCharClass(*pos) & (CharClassNewLine | CharClassEnd)))
+                pos++;
+        }
+        else
+            break;
+    }
+
+    outToken.mLineNumber = mLineNumber;
 
     // End of file
-    if (*mSourceStringPos == 0)
+    if (pos >= end || *pos == 0)
     {
+        mSourceStringPos = pos;
         outToken.mTokenType = ETokenType::EndOfFile;
         return outToken;
     }
 
-    const char* tokenStart = mSourceStringPos;
+    const char* tokenStart = pos;
+    const uint8_t firstCharClass = GetCharClass(*pos);
+    pos++;
 
-    bool isStringLiteral = false;
-    bool isNumericLiteral = false;
-    bool isFloatLiteral = false;
-    bool isPunctuator = false;
-    bool isComment = false;
-    const char* commentStartPos;
-
-    // Evaluate the first character
-    if (*mSourceStringPos == '"')
+    if (firstCharClass & CharClassNewLine)
     {
-       isStringLiteral = true;
-       mSourceStringPos++;
+        mLineNumber++; // count linebreaks
+        outToken.mTokenType = ETokenType::NewLine;
     }
-    else if (isdigit(*mSourceStringPos))
+    else if (firstCharClass & CharClassQuote)
     {
-        isNumericLiteral = true;
+        while (pos < end && *pos != '"' && *pos != 0)
+        {
+            if (*pos == '\n')
+                mLineNumber++;
+            pos++;
+        }
+        if (pos < end && *pos == '"')
+            pos++;
+        outToken.mTokenType = ETokenType::StringLiteral;
     }
-    else if (*mSourceStringPos == '/' && *(mSourceStringPos + 1) == '/')
+    else if (IsTokenPaste(tokenStart, end))
     {
-        isComment = true;
-        commentStartPos = mSourceStringPos;
-        mSourceStringPos++;
+        pos++;
+        outToken.mTokenType = ETokenType::Operator;
     }
-    else if (mPunctuators.find(*mSourceStringPos) != mPunctuators.end())
+    else if (firstCharClass & CharClassPunctuator)
     {
-        isPunctuator = true;
+        // Double punctuator? (>=, ==, !=, etc..)
+        if (pos < end && IsDoublePunctuator(*tokenStart, *pos))
+        {
+            outToken.mOperator = GetDoubleOperator(*tokenStart, *pos);
+            pos++;
+        }
+        else
+            outToken.mOperator = kCharTables.mSingleOperator[static_cast<uint8_t>(*tokenStart)];
+        outToken.mTokenType = ETokenType::Operator;
     }
-    mSourceStringPos++;
-
-    // Evaluate the rest of the characters
-    while (*mSourceStringPos != 0)
+    else if (firstCharClass & CharClassDigit)
     {
-        const char& currChar = *mSourceStringPos;
-        if (isComment)
+        bool isFloatLiteral = false;
+        int intValue = *tokenStart - '0';
+        while (pos < end)
         {
-            if (currChar == '\n')
+            const char currChar = *pos;
+            const uint8_t charClass = GetCharClass(currChar);
+            if (charClass & CharClassDigit)
             {
-                mSourceStringPos++;
-                mLineNumber++;
-                break;
+                intValue = intValue * 10 + (currChar - '0');
             }
-        }
-        else if (isStringLiteral)
-        {
-           if (*mSourceStringPos == '"')
-           {
-              mSourceStringPos++;
-              break;
-           }
-        }
-        else if (isPunctuator)
-        {
-            // Double punctuator? (>=, ==, !=, etc..)
-            if (mDoublePunctuators.find(std::string{ *(mSourceStringPos - 1), *mSourceStringPos }) != mDoublePunctuators.end())
+            else if (currChar == '.')
             {
-                mSourceStringPos++;
+                isFloatLiteral = true;
             }
-            break;
-        }
-        else if (currChar == ';' || currChar == ' ' || currChar == '\n' || currChar == '\t' || ((!isNumericLiteral || currChar != '.') && mPunctuators.find(currChar) != mPunctuators.end()))
-        {
-            break;
-        }
-        else if (isNumericLiteral)
-        {
-            if (currChar == '.')
+            else if (charClass & (CharClassWhitespace | CharClassNewLine | CharClassPunctuator | CharClassEnd))
             {
-                isFloatLiteral = true;
+                break;
             }
             else if (currChar == 'f')
             {
                 if (isFloatLiteral)
                 {
-                    mSourceStringPos++;
+                    pos++;
                     break;
                 }
                 else
                 {
-                    LOG_ERROR() << "Invalid character 'f' in numeric literal: " << tokenStart;
+                    LOG_ERROR() << "Invalid character 'f' in numeric literal: " << std::string(tokenStart, pos + 1 - tokenStart);
                 }
             }
-            else if (!isdigit(currChar))
+            else
             {
-                LOG_ERROR() << "Invalid character in numerical literal: " << tokenStart;
+                LOG_ERROR() << "Invalid character in numerical literal: " << std::string(tokenStart, pos + 1 - tokenStart);
             }
+            pos++;
         }
-        mSourceStringPos++;
-    }
-
-    const char* tokenEnd = isComment ? commentStartPos : mSourceStringPos;
-
-    outToken.mTokenString = std::string(tokenStart, tokenEnd - tokenStart);
 
-    if (isStringLiteral)
-    {
-       outToken.mTokenType = ETokenType::StringLiteral;
-    }
-    else if (isNumericLiteral && isFloatLiteral)
-    {
-        outToken.mTokenType = ETokenType::FloatLiteral;
-        outToken.mFloatValue = strtof(outToken.mTokenString.c_str(), nullptr);
-    }
-    else if (isNumericLiteral)
-    {
-        outToken.mTokenType = ETokenType::IntegerLiteral;
-        outToken.mIntValue = strtol(outToken.mTokenString.c_str(), nullptr, 10);
-    }
-    else if (outToken.mTokenString == "true")
-    {
-        outToken.mTokenType = ETokenType::BooleanLiteral;
-        outToken.mIntValue = 1;
-    }
-    else if (outToken.mTokenString == "false")
-    {
-        outToken.mTokenType = ETokenType::BooleanLiteral;
-        outToken.mIntValue = 0;
-    }
-    else if (isPunctuator)
-    {
-        outToken.mTokenType = ETokenType::Operator;
-    }
-    else if (outToken.mTokenString[0] == '#')
-    {
-        outToken.mTokenType = ETokenType::PreprocessorDirective;
+        if (isFloatLiteral)
+        {
+            outToken.mTokenType = ETokenType::FloatLiteral;
+            std::from_chars(tokenStart, pos, outToken.mFloatValue);
+        }
+        else
+        {
+            outToken.mTokenType = ETokenType::IntegerLiteral;
+            outToken.mIntValue = intValue;
+        }
     }
     else
     {
-        outToken.mTokenType = ETokenType::Identifier;
+        // Identifier, keyword or preprocessor directive
+        while (pos < end && !(GetCharClass(*pos) & (CharClassWhitespace | CharClassNewLine | CharClassPunctuator | CharClassEnd)))
+        {
+            if ((GetCharClass(*pos) & CharClassHash) && IsTokenPaste(pos, end))
+                break;
+            pos++;
+        }
+
+        const size_t length = pos - tokenStart;
+        if (length == 4 && memcmp(tokenStart, "true", 4) == 0)
+        {
+            outToken.mTokenType = ETokenType::BooleanLiteral;
+            outToken.mIntValue = 1;
+        }
+        else if (length == 5 && memcmp(tokenStart, "false", 5) == 0)
+        {
+            outToken.mTokenType = ETokenType::BooleanLiteral;
+            outToken.mIntValue = 0;
+        }
+        else if (*tokenStart == '#')
+        {
+            outToken.mTokenType = ETokenType::PreprocessorDirective;
+        }
+        else
+        {
+            outToken.mTokenType = ETokenType::Identifier;
+            outToken.mIdentifierID = InternIdentifier(std::string_view(tokenStart, length));
+        }
     }
 
-    outToken.mLineNumber = mLineNumber;
+    outToken.mTokenString = std::string_view(tokenStart, pos - tokenStart);
+    mSourceStringPos = pos;
 
     return outToken;
 }
 
-TokenParser::TokenParser(const char* inShaderCode)
-    : mTokeniser(inShaderCode)
+TokenParser::TokenParser(TokenSource* tokenSource)
 {
-    const char* shaderStringPos = inShaderCode;
-    while (*shaderStringPos != 0)
-    {
-        Token token = mTokeniser.ParseToken();
-        if (token.mTokenString != "")
-        {
-            mTokens.push_back(token);
-        }
-        else if (token.mTokenType == ETokenType::EndOfFile)
-        {
-            break;
-        }
-    }
+    mTokenSource = tokenSource;
 }
 
-void TokenParser::ResetPosition()
+void TokenParser::BufferTokens(const size_t inNumTokens)
 {
-    mCurrentTokenIndex = 0;
+    assert(inNumTokens <= MaxLookahead);
+    while (mNumBufferedTokens < inNumTokens)
+    {
+        mLookahead[(mCurrentTokenIndex + mNumBufferedTokens) & (MaxLookahead - 1)] = mTokenSource->NextToken();
+        mNumBufferedTokens++;
+    }
 }
 
 void TokenParser::Advance()
 {
-    mCurrentTokenIndex++;
+    BufferTokens(1);
+    mCurrentTokenIndex = (mCurrentTokenIndex + 1) & (MaxLookahead - 1);
+    mNumBufferedTokens--;
 }
 
 const Token& TokenParser::GetCurrentToken()
 {
-    return mTokens[mCurrentTokenIndex];
+    BufferTokens(1);
+    return mLookahead[mCurrentTokenIndex];
 }
 
 const Token& TokenParser::GetTokenFromOffset(const int inOffset)
 {
-    return mTokens[mCurrentTokenIndex + inOffset];
+    BufferTokens(inOffset + 1);
+    return mLookahead[(mCurrentTokenIndex + inOffset) & (MaxLookahead - 1)];
 }
 
 bool TokenParser::HasMoreTokens()
 {
-    return mCurrentTokenIndex < mTokens.size();
-}
-
-void TokenParser::SetTokens(std::vector<Token>& inTokens)
-{
-    mTokens = inTokens;
+    return GetCurrentToken().mTokenType != ETokenType::EndOfFile;
 }
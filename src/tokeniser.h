@@ -1,9 +1,13 @@
 #pragma once
 
 #include <vector>
-#include <set>
+#include <string>
+#include <string_view>
 #include <unordered_map>
 #include <stack>
+#include <stdint.h>
+#include "identifier_table.h"
+#include "operator.h"
 
 enum class ETokenType
 {
@@ -18,50 +22,103 @@ enum class ETokenType
     NewLine
 };
 
+/**
+* A token. The token string is a view into the source buffer, which is owned by the CompilationUnit.
+*/
 class Token
 {
 public:
     ETokenType mTokenType;
-    std::string mTokenString;
-    float mFloatValue;
-    int mIntValue;
-    int mLineNumber;
+    std::string_view mTokenString;
+    IdentifierID mIdentifierID = InvalidIdentifierID; // interned name (identifiers only)
+    bool mNoExpand = false; // names a macro that was disabled when this token was read, so it's never expanded
+    EOperator mOperator = EOperator::None; // classified operator (operators only)
+    float mFloatValue = 0.0f;
+    int mIntValue = 0;
+    int mLineNumber = 0;
 };
 
-class Tokeniser
+/**
+* A stream of tokens, pulled one at a time.
+* Returns an EndOfFile token when there are no more tokens.
+*/
+class TokenSource
+{
+public:
+    virtual ~TokenSource() {}
+
+    virtual Token NextToken() = 0;
+};
+
+/**
+* Reads tokens from a list. The list must outlive the source.
+*/
+class TokenListSource : public TokenSource
+{
+private:
+    const std::vector<Token>& mTokens;
+    size_t mTokenIndex = 0;
+
+public:
+    TokenListSource(const std::vector<Token>& tokens) : mTokens(tokens) {}
+
+    virtual Token NextToken() override;
+};
+
+/**
+* Single-pass lexer.
+* Characters are classified through a 256-entry lookup table (see tokeniser.cpp),
+*  and double punctuators (==, >=, ->, etc.) are recognised by a two-state DFA.
+* Operators are classified (EOperator) here, so later stages never compare operator strings.
+* The source text is not copied, and must outlive the tokens.
+*/
+class Tokeniser : public TokenSource
 {
 private:
-    const std::set<char> mPunctuators = { '[', ']', '(' , ')' , '{' , '}' , ',' , '.' , ';' , ':' , '<', '>', '=', '!', '+', '-', '*', '/', '&', '|', '?' };
-    const std::set<std::string> mDoublePunctuators = { "==", ">=", "<=", "!=", "&&", "||", "+=", "*=", "/=", "&=", "|=", "->" };
+    struct IdentifierCacheEntry
+    {
+        std::string_view mName; // refers to the identifier table
+        IdentifierID mID = InvalidIdentifierID;
+    };
+    static const size_t IdentifierCacheSize = 256; // power of two
 
-    std::string mSourceText;
+    IdentifierTable* mIdentifierTable;
     const char* mSourceStringPos;
+    const char* mSourceEnd;
     int mLineNumber = 1;
+    // Recently interned identifiers. Avoids locking the shared identifier table for most identifiers.
+    std::vector<IdentifierCacheEntry> mIdentifierCache;
 
-    bool isOperator(const char* inToken);
+    IdentifierID InternIdentifier(std::string_view name);
 
 public:
-    Tokeniser(const char* inSourceText);
+    Tokeniser(const char* inSourceText, size_t inLength, IdentifierTable* identifierTable);
 
     Token ParseToken();
+
+    virtual Token NextToken() override { return ParseToken(); }
 };
 
+/**
+* Reads tokens from a TokenSource on demand.
+* Only a small ring buffer of lookahead tokens is kept, so memory use doesn't depend on the source size.
+*/
 class TokenParser
 {
 private:
-    Tokeniser mTokeniser;
-    std::vector<Token> mTokens;
-    size_t mCurrentTokenIndex = 0;
+    static const size_t MaxLookahead = 4; // power of two
+
+    TokenSource* mTokenSource;
+    Token mLookahead[MaxLookahead];
+    size_t mCurrentTokenIndex = 0; // ring buffer index of current token
+    size_t mNumBufferedTokens = 0;
+
+    void BufferTokens(const size_t inNumTokens);
 
 public:
-    TokenParser(const char* inShaderCode);
-    void ResetPosition();
+    TokenParser(TokenSource* tokenSource);
     void Advance();
     const Token& GetCurrentToken();
     const Token& GetTokenFromOffset(const int inOffset);
     bool HasMoreTokens();
-    void SetTokens(std::vector<Token>& inTokens);
-
-    size_t GetCurrentTokenIndex() { return mCurrentTokenIndex; };
-    std::vector<Token>& GetTokens() { return mTokens; };
 };
@@ -0,0 +1,40 @@
+# A cache hit skips parsing, analysis and code generation and gives the same ROM. Units with errors aren't cached.
+include("${CMAKE_CURRENT_LIST_DIR}/cnes_test.cmake")
+
+file(REMOVE_RECURSE "${WORK_DIR}")
+file(MAKE_DIRECTORY "${WORK_DIR}/cache")
+
+# The analyser prints the symbol table of each unit it analyses
+cnes_build("${SOURCE_DIR}/inline_asm.c" -cache cache)
+if(NOT CNES_OUTPUT MATCHES "0 hits, 1 misses" OR NOT CNES_OUTPUT MATCHES "SYMBOL TABLE")
+    message(FATAL_ERROR "Expected a compiled cache miss:\n${CNES_OUTPUT}")
+endif()
+set(missRom "${ROM_HEX}")
+
+cnes_build("${SOURCE_DIR}/inline_asm.c" -cache cache)
+if(NOT CNES_OUTPUT MATCHES "1 hits, 0 misses" OR CNES_OUTPUT MATCHES "SYMBOL TABLE")
+    message(FATAL_ERROR "Expected a cache hit that skips the compiler:\n${CNES_OUTPUT}")
+endif()
+if(NOT ROM_HEX STREQUAL missRom)
+    message(FATAL_ERROR "The ROM built from the cache differs from the compiled one")
+endif()
+
+# The error is reported again by the second build
+file(WRITE "${WORK_DIR}/error.c" "struct s { uint8_t m; };\nstruct s { uint8_t m; };\nuint8_t a;\n\nvoid main()\n{\n    a = 1;\n}\n")
+foreach(build 1 2)
+    cnes_run(error.c -cache cache -o error.nes)
+    if(NOT CNES_OUTPUT MATCHES "Struct already defined" OR NOT CNES_OUTPUT MATCHES "0 hits, 1 misses")
+        message(FATAL_ERROR "Expected the error to be reported by build ${build}:\n${CNES_OUTPUT}")
+    endif()
+endforeach()
+
+# A header with lexer errors is only tokenised once, but no unit that includes it is cached
+file(WRITE "${WORK_DIR}/bad_literal.h" "#define BAD_LITERAL 12g\nuint8_t shared;\n")
+file(WRITE "${WORK_DIR}/include_a.c" "#include \"bad_literal.h\"\n\nvoid f()\n{\n    shared = 1;\n}\n")
+file(WRITE "${WORK_DIR}/include_b.c" "#include \"bad_literal.h\"\n\nvoid g()\n{\n    shared = 2;\n}\n")
+foreach(build 1 2)
+    cnes_run(include_a.c include_b.c -c -cache cache)
+    if(NOT CNES_OUTPUT MATCHES "0 hits, 2 misses")
+        message(FATAL_ERROR "Expected no unit including the header to be cached, in build ${build}:\n${CNES_OUTPUT}")
+    endif()
+endforeach()
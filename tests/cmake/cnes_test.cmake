@@ -0,0 +1,28 @@
+# Helpers for the tests, run with: cmake -DCNES=<compiler> -DWORK_DIR=<dir> -DSOURCE_DIR=<tests dir> -P <test>.cmake
+
+# Runs CNES with the given arguments in WORK_DIR. Its output is returned in CNES_OUTPUT.
+function(cnes_run)
+    # CNES waits for a key press when done, so its input is a file
+    execute_process(COMMAND "${CNES}" ${ARGN}
+        WORKING_DIRECTORY "${WORK_DIR}"
+        INPUT_FILE "${CMAKE_CURRENT_LIST_FILE}"
+        OUTPUT_VARIABLE output
+        ERROR_VARIABLE output)
+    set(CNES_OUTPUT "${output}" PARENT_SCOPE)
+endfunction()
+
+# Compiles and links the inputs in WORK_DIR. Fails the test on any error, or if no ROM is written.
+# The ROM is returned as a hex string in ROM_HEX, and the output in CNES_OUTPUT.
+function(cnes_build)
+    file(REMOVE "${WORK_DIR}/testrom.nes")
+    cnes_run(${ARGN} -o testrom.nes)
+    if(CNES_OUTPUT MATCHES "ERROR")
+        message(FATAL_ERROR "Build failed:\n${CNES_OUTPUT}")
+    endif()
+    if(NOT EXISTS "${WORK_DIR}/testrom.nes")
+        message(FATAL_ERROR "No ROM written:\n${CNES_OUTPUT}")
+    endif()
+    file(READ "${WORK_DIR}/testrom.nes" romHex HEX)
+    set(ROM_HEX "${romHex}" PARENT_SCOPE)
+    set(CNES_OUTPUT "${CNES_OUTPUT}" PARENT_SCOPE)
+endfunction()
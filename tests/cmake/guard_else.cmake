@@ -0,0 +1,5 @@
+# A header whose #ifndef has an #else branch is preprocessed again when included a second time.
+include("${CMAKE_CURRENT_LIST_DIR}/cnes_test.cmake")
+
+file(MAKE_DIRECTORY "${WORK_DIR}")
+cnes_build("${SOURCE_DIR}/guard_else.c")
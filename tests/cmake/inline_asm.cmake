@@ -0,0 +1,12 @@
+# Inline assembly comes out byte for byte as written, even where the peephole rules would match.
+include("${CMAKE_CURRENT_LIST_DIR}/cnes_test.cmake")
+
+file(MAKE_DIRECTORY "${WORK_DIR}")
+cnes_build("${SOURCE_DIR}/inline_asm.c")
+
+# LDA #$3F; STA value; LDA value; STA $4000 (value is the only data, so the linker puts it at $00)
+set(expected "a93f8500a5008d0040")
+string(FIND "${ROM_HEX}" "${expected}" found)
+if(found EQUAL -1)
+    message(FATAL_ERROR "Inline assembly was changed: ${expected} not found in the ROM")
+endif()
@@ -0,0 +1,28 @@
+# Units whose data doesn't all fit in zero page still link: the rest goes to the other RAM pages.
+include("${CMAKE_CURRENT_LIST_DIR}/cnes_test.cmake")
+
+set(numUnits 9)
+set(varsPerUnit 33)
+
+file(MAKE_DIRECTORY "${WORK_DIR}")
+set(inputs "")
+set(mainSource "")
+set(calls "")
+foreach(unit RANGE 1 ${numUnits})
+    set(source "")
+    set(body "")
+    foreach(var RANGE 1 ${varsPerUnit})
+        string(APPEND source "uint8_t u${unit}_v${var};\n")
+        string(APPEND body "    u${unit}_v${var} = ${var};\n")
+    endforeach()
+    string(APPEND source "\nvoid f${unit}()\n{\n${body}}\n")
+    file(WRITE "${WORK_DIR}/u${unit}.c" "${source}")
+    list(APPEND inputs "u${unit}.c")
+    string(APPEND mainSource "void f${unit}();\n")
+    set(calls "${calls}    f${unit}();\n")
+endforeach()
+string(APPEND mainSource "\nvoid main()\n{\n${calls}}\n")
+file(WRITE "${WORK_DIR}/main.c" "${mainSource}")
+list(APPEND inputs "main.c")
+
+cnes_build(${inputs})
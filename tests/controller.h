@@ -9,6 +9,14 @@ uint8_t ctrl0_buttons;
 #define CTRL_BUTTON_LEFT 2
 #define CTRL_BUTTON_RIGHT 1
 
+// Shifts the next button state (from $4016) into the given variable
+#define READ_CTRL_BUTTON(buttons) \
+    __asm lda $4016 \
+    __asm lsr A \
+    __asm rol buttons
+#define READ_CTRL_BUTTONS_2(buttons) READ_CTRL_BUTTON(buttons) READ_CTRL_BUTTON(buttons)
+#define READ_CTRL_BUTTONS(buttons) READ_CTRL_BUTTONS_2(buttons) READ_CTRL_BUTTONS_2(buttons) READ_CTRL_BUTTONS_2(buttons) READ_CTRL_BUTTONS_2(buttons)
+
 uint8_t read_ctrl_0()
 {
     __asm clc
@@ -18,30 +26,7 @@ uint8_t read_ctrl_0()
     __asm lsr A
     __asm sta $4016
     
-    __asm lda $4016
-    __asm lsr A
-    __asm rol ctrl0_buttons
-    __asm lda $4016
-    __asm lsr A
-    __asm rol ctrl0_buttons
-    __asm lda $4016
-    __asm lsr A
-    __asm rol ctrl0_buttons
-    __asm lda $4016
-    __asm lsr A
-    __asm rol ctrl0_buttons
-    __asm lda $4016
-    __asm lsr A
-    __asm rol ctrl0_buttons
-    __asm lda $4016
-    __asm lsr A
-    __asm rol ctrl0_buttons
-    __asm lda $4016
-    __asm lsr A
-    __asm rol ctrl0_buttons
-    __asm lda $4016
-    __asm lsr A
-    __asm rol ctrl0_buttons
+    READ_CTRL_BUTTONS(ctrl0_buttons)
     return ctrl0_buttons;    
 }
 
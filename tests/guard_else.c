@@ -0,0 +1,9 @@
+// The #else of the header's #ifndef is taken on the second include, so it isn't an include guard
+#include "guard_else.h"
+#include "guard_else.h"
+
+void main()
+{
+    first = 1;
+    second = 2;
+}
@@ -0,0 +1,6 @@
+#ifndef GUARD_ELSE_H
+#define GUARD_ELSE_H
+uint8_t first;
+#else
+uint8_t second;
+#endif
@@ -0,0 +1,15 @@
+// Inline assembly is emitted as written: none of these are optimised away
+uint8_t value;
+
+void write_value()
+{
+    __asm LDA #$3F
+    __asm STA value
+    __asm LDA value
+    __asm STA $4000
+}
+
+void main()
+{
+    write_value();
+}